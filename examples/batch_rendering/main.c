@@ -4,6 +4,7 @@
 
 #include <shlib/shlib.h>
 #include <stdio.h>
+#include <math.h>
 
 #define MAX_QUADS 25
 
@@ -43,27 +44,91 @@ const char *line_vert_src = "#version 400 core\n"
                          "\n"
                          "layout (location = 0) in vec3 aPosition;\n"
                          "layout (location = 1) in vec4 aColor;\n"
+                         "layout (location = 2) in vec4 aEdge;\n"
                          "\n"
                          "uniform mat4 uProjection;\n"
                          "\n"
                          "out vec4 fColor;\n"
+                         "out vec4 fEdge;\n"
                          "\n"
                          "void main()\n"
                          "{\n"
                          "    fColor = aColor;\n"
+                         "    fEdge = aEdge;\n"
                          "    gl_Position = uProjection * vec4(aPosition, 1);\n"
                          "}";
 const char *line_frag_src = "#version 400 core\n"
                            "\n"
                            "in vec4 fColor;\n"
+                           "in vec4 fEdge;\n"
                            "\n"
                            "out vec4 oColor;\n"
                            "\n"
                            "void main()\n"
                            "{\n"
-                           "    oColor = fColor;\n"
+                           "    float a = clamp(fEdge.y - abs(fEdge.x), 0.0, 1.0) * clamp(min(fEdge.z, fEdge.w), 0.0, 1.0);\n"
+                           "    oColor = vec4(fColor.rgb, fColor.a * a);\n"
                            "}";
 
+const char *shape_vert_src = "#version 400 core\n"
+                          "\n"
+                          "layout (location = 0) in vec3 aPosition;\n"
+                          "layout (location = 1) in vec4 aColor;\n"
+                          "layout (location = 2) in vec2 aLocal;\n"
+                          "layout (location = 3) in vec4 aShape;\n"
+                          "layout (location = 4) in vec2 aArc;\n"
+                          "\n"
+                          "uniform mat4 uProjection;\n"
+                          "\n"
+                          "out vec4 fColor;\n"
+                          "out vec2 fLocal;\n"
+                          "out vec4 fShape;\n"
+                          "out vec2 fArc;\n"
+                          "\n"
+                          "void main()\n"
+                          "{\n"
+                          "    fColor = aColor;\n"
+                          "    fLocal = aLocal;\n"
+                          "    fShape = aShape;\n"
+                          "    fArc = aArc;\n"
+                          "    gl_Position = uProjection * vec4(aPosition, 1);\n"
+                          "}";
+const char *shape_frag_src = "#version 400 core\n"
+                            "\n"
+                            "in vec4 fColor;\n"
+                            "in vec2 fLocal;\n"
+                            "in vec4 fShape;\n"
+                            "in vec2 fArc;\n"
+                            "\n"
+                            "out vec4 oColor;\n"
+                            "\n"
+                            "void main()\n"
+                            "{\n"
+                            "    float d;\n"
+                            "    if (fArc.y > 0.0)\n"
+                            "    {\n"
+                            "        float half_thickness = fShape.w * 0.5;\n"
+                            "        d = abs(length(fLocal) - fShape.z + half_thickness) - half_thickness;\n"
+                            "        if (fArc.y < 3.14159)\n"
+                            "        {\n"
+                            "            vec2 axis = vec2(cos(fArc.x), sin(fArc.x));\n"
+                            "            vec2 p = vec2(abs(dot(fLocal, vec2(-axis.y, axis.x))), dot(fLocal, axis));\n"
+                            "            vec2 edge = vec2(sin(fArc.y), cos(fArc.y));\n"
+                            "            float cut = length(p - edge * max(dot(p, edge), 0.0));\n"
+                            "            d = max(d, cut * sign(edge.y * p.x - edge.x * p.y));\n"
+                            "        }\n"
+                            "    }\n"
+                            "    else\n"
+                            "    {\n"
+                            "        vec2 q = abs(fLocal) - fShape.xy + fShape.z;\n"
+                            "        d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - fShape.z;\n"
+                            "        if (fShape.w > 0.0)\n"
+                            "            d = abs(d + fShape.w * 0.5) - fShape.w * 0.5;\n"
+                            "    }\n"
+                            "    float alpha = clamp(0.5 - d / max(fwidth(d), 0.0001), 0.0, 1.0);\n"
+                            "    oColor = vec4(fColor.rgb, fColor.a * alpha);\n"
+                            "}";
+
 
 int main()
 {
@@ -71,7 +136,17 @@ int main()
     Batch *batch = batch_create(100);
     Shader *quad_shader = shader_load(quad_vert_src, quad_frag_src);
     Shader *line_shader = shader_load(line_vert_src, line_frag_src);
-    Matrix projection = matrix_ortho(0, 800, 600, 0, -1.0f, 1.0f);
+    Shader *shape_shader = shader_load(shape_vert_src, shape_frag_src);
+    Matrix projection = matrix_ortho(0, 800, 0, 600, -1.0f, 1.0f);
+
+    // Built once, the flattened outline and fill are reused every frame
+    Path *heart = path_create();
+    path_move_to(heart, (Vec2){80, 390});
+    path_cubic_to(heart, (Vec2){80, 370}, (Vec2){50, 355}, (Vec2){35, 370});
+    path_cubic_to(heart, (Vec2){20, 385}, (Vec2){35, 405}, (Vec2){80, 430});
+    path_cubic_to(heart, (Vec2){125, 405}, (Vec2){140, 385}, (Vec2){125, 370});
+    path_cubic_to(heart, (Vec2){110, 355}, (Vec2){80, 370}, (Vec2){80, 390});
+    path_close(heart);
 
     while(!window_should_close())
     {
@@ -86,6 +161,43 @@ int main()
 
         batch_add_line(batch, (Vec2){700, 500}, (Vec2){100, 100}, (Vec4){1, 1, 0, 1}, 1);
 
+        Vec2 points[8];
+        for (i = 0; i < 8; i++)
+            points[i] = (Vec2){100 + 85 * i, i % 2 ? 450 : 500};
+
+        batch_set_line_style(batch, LINE_JOIN_ROUND, LINE_CAP_ROUND);
+        batch_add_polyline(batch, points, 8, (Vec4){0, 1, 1, 1}, 6, false);
+        batch_set_line_style(batch, LINE_JOIN_MITER, LINE_CAP_BUTT);
+
+        batch_add_rounded_rect(batch, (Vec2){400, 150}, (Vec2){620, 140}, 16, (Vec4){0.2f, 0.2f, 0.25f, 1});
+        for (i = 0; i < 4; i++)
+        {
+            Vec2 center = {175 + 150 * i, 150};
+            batch_add_ring(batch, center, 50, 4, (Vec4){0.4f, 0.4f, 0.45f, 1});
+            batch_add_arc(batch, center, 50, 8, 0, 1.5f * (i + 1), (Vec4){1, 0.6f, 0.1f, 1});
+            batch_add_circle(batch, center, 6, (Vec4){1, 1, 1, 1});
+        }
+
+        Vec2 star[10];
+        for (i = 0; i < 10; i++)
+        {
+            float radius = i % 2 ? 25 : 60;
+            star[i] = (Vec2){700 + radius * cosf(0.628f * i), 320 + radius * sinf(0.628f * i)};
+        }
+
+        batch_add_polygon(batch, star, 10, (Vec4){0.9f, 0.3f, 0.4f, 1});
+
+        // A panel whose contents scroll past its edges, cut by the clip rect
+        float scroll = fmodf((float)input_get_time() * 40.0f, 60.0f);
+        batch_add_quad(batch, (Vec2){440, 565}, (Vec2){200, 50}, (Vec4){0.2f, 0.2f, 0.25f, 1});
+        batch_push_clip(batch, (Vec2){340, 540}, (Vec2){200, 50});
+        for (i = 0; i < 6; i++)
+            batch_add_quad(batch, (Vec2){340 + 60 * i - scroll, 565}, (Vec2){40, 30}, (Vec4){0.3f, 0.7f, 1, 1});
+        batch_pop_clip(batch);
+
+        batch_fill_path(batch, heart, (Vec4){0.8f, 0.1f, 0.2f, 1});
+        batch_stroke_path(batch, heart, (Vec4){1, 1, 1, 1}, 2);
+
         shader_upload_matrix(quad_shader, "uProjection", projection);
         shader_use(quad_shader);
         graphics_draw_batch_quads(batch);
@@ -94,8 +206,13 @@ int main()
         shader_use(line_shader);
         graphics_draw_batch_lines(batch);
 
+        shader_upload_matrix(shape_shader, "uProjection", projection);
+        shader_use(shape_shader);
+        graphics_draw_batch_shapes(batch);
+
         window_swap_buffers();
     }
+    path_destroy(heart);
     batch_destroy(batch);
     window_destroy();
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <shlib/shlib.h>
+#include <stdio.h>
+
+#define MAX_QUADS 1000
+#define NUM_SIZES 6
+
+const char *quad_vert_src = "#version 400 core\n"
+                         "\n"
+                         "layout (location = 0) in vec3 aPosition;\n"
+                         "layout (location = 1) in vec4 aColor;\n"
+                         "layout (location = 2) in vec2 aTexCoord;\n"
+                         "layout (location = 3) in float aTexId;\n"
+                         "\n"
+                         "uniform mat4 uProjection;\n"
+                         "\n"
+                         "out vec4 fColor;\n"
+                         "out vec2 fTexCoord;\n"
+                         "out float fTexId;\n"
+                         "\n"
+                         "void main()\n"
+                         "{\n"
+                         "    fColor = aColor;\n"
+                         "    fTexCoord = aTexCoord;\n"
+                         "    fTexId = aTexId;\n"
+                         "    gl_Position = uProjection * vec4(aPosition, 1);\n"
+                         "}";
+const char *quad_frag_src = "#version 400 core\n"
+                           "\n"
+                           "in vec4 fColor;\n"
+                           "in vec2 fTexCoord;\n"
+                           "in float fTexId;\n"
+                           "\n"
+                           "uniform sampler2D uTextures[16];\n"
+                           "\n"
+                           "out vec4 oColor;\n"
+                           "\n"
+                           "void main()\n"
+                           "{\n"
+                           "    float a = texture(uTextures[int(fTexId)], fTexCoord).r;\n"
+                           "    oColor = fColor * a;\n"
+                           "}";
+
+int main()
+{
+    window_init(800, 600, "Example 9 - Font Cache");
+
+    float sizes[NUM_SIZES] = {12, 14, 16, 20, 24, 32};
+    FontRange ranges[2] = {{32, 95}, {160, 96}};
+    Font *fonts[NUM_SIZES];
+    char cache_path[64];
+    int i;
+
+    // Baking every size from scratch, as a first run without a cache would
+    double start = input_get_time();
+    for (i = 0; i < NUM_SIZES; i++)
+        font_unload(font_load_packed("./retro.ttf", sizes[i], ranges, 2, 2, 1));
+    double baked_time = input_get_time() - start;
+
+    // Writes the cache files the first time this runs and reads them after that
+    start = input_get_time();
+    for (i = 0; i < NUM_SIZES; i++)
+    {
+        sprintf(cache_path, "./retro_%d.fontcache", (int)sizes[i]);
+        fonts[i] = font_load_cached("./retro.ttf", sizes[i], ranges, 2, 2, 1, cache_path);
+    }
+    double cached_time = input_get_time() - start;
+
+    printf("%d fonts baked: %.2f ms, loaded through the cache: %.2f ms\n", NUM_SIZES, baked_time * 1000.0, cached_time * 1000.0);
+
+    Batch *batch = batch_create(MAX_QUADS);
+    Shader *shader = shader_load(quad_vert_src, quad_frag_src);
+    int samplers[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    shader_upload_int_array(shader, "uTextures", 16, samplers);
+    Matrix projection = matrix_ortho(0, 800, 600, 0, -1.0f, 1.0f);
+
+    while(!window_should_close())
+    {
+        window_poll_events();
+        graphics_clear_screen((Vec4){0.1f, 0.1f, 0.1f});
+
+        float y = 560;
+        for (i = 0; i < NUM_SIZES; i++)
+        {
+            batch_add_text_scaled(batch, (Vec2){20, y}, fonts[i], "The quick brown fox, caf\xc3\xa9 \xc2\xbd", sizes[i], (Vec4){1, 1, 1, 1});
+            y -= font_get_line_height(fonts[i], sizes[i]) + 8;
+        }
+
+        shader_upload_matrix(shader, "uProjection", projection);
+        shader_use(shader);
+        graphics_draw_batch_quads(batch);
+
+        window_swap_buffers();
+    }
+
+    for (i = 0; i < NUM_SIZES; i++)
+        font_unload(fonts[i]);
+    shader_unload(shader);
+    batch_destroy(batch);
+    window_destroy();
+}
@@ -0,0 +1,85 @@
+#include <shlib/shlib.h>
+#include <stdio.h>
+
+#define MAX_QUADS 10000
+
+const char *quad_vert_src = "#version 400 core\n"
+                         "\n"
+                         "layout (location = 0) in vec2 aCenter;\n"
+                         "layout (location = 1) in vec2 aHalfSize;\n"
+                         "layout (location = 2) in float aRotation;\n"
+                         "layout (location = 3) in vec4 aColor;\n"
+                         "layout (location = 4) in vec4 aTexRect;\n"
+                         "layout (location = 5) in uint aTexId;\n"
+                         "\n"
+                         "const vec2 corners[6] = vec2[](vec2(-1, 1), vec2(1, 1), vec2(1, -1),\n"
+                         "                               vec2(1, -1), vec2(-1, -1), vec2(-1, 1));\n"
+                         "\n"
+                         "uniform mat4 uProjection;\n"
+                         "\n"
+                         "out vec4 fColor;\n"
+                         "out vec2 fTexCoord;\n"
+                         "flat out uint fTexId;\n"
+                         "\n"
+                         "void main()\n"
+                         "{\n"
+                         "    vec2 local = corners[gl_VertexID];\n"
+                         "    vec2 offset = local * aHalfSize;\n"
+                         "    float s = sin(aRotation);\n"
+                         "    float c = cos(aRotation);\n"
+                         "    vec2 position = aCenter + vec2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);\n"
+                         "\n"
+                         "    fColor = aColor;\n"
+                         "    fTexCoord = mix(aTexRect.xy, aTexRect.zw, local * 0.5 + 0.5);\n"
+                         "    fTexId = aTexId;\n"
+                         "    gl_Position = uProjection * vec4(position, 0, 1);\n"
+                         "}";
+const char *quad_frag_src = "#version 400 core\n"
+                           "\n"
+                           "in vec4 fColor;\n"
+                           "in vec2 fTexCoord;\n"
+                           "flat in uint fTexId;\n"
+                           "\n"
+                           "uniform sampler2D uTextures[16];\n"
+                           "\n"
+                           "out vec4 oColor;\n"
+                           "\n"
+                           "void main()\n"
+                           "{\n"
+                           "    oColor = fColor * texture(uTextures[fTexId], fTexCoord);\n"
+                           "}";
+
+int main()
+{
+    window_init(800, 600, "Example 7 - Instanced Batch");
+    Batch *batch = batch_create_with_options((BatchOptions){MAX_QUADS, BATCH_INSTANCED | BATCH_STREAMING, 3});
+    Shader *shader = shader_load(quad_vert_src, quad_frag_src);
+    int samplers[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    shader_upload_int_array(shader, "uTextures", 16, samplers);
+    Matrix projection = matrix_ortho(0, 800, 600, 0, -1.0f, 1.0f);
+
+    while(!window_should_close())
+    {
+        window_poll_events();
+        graphics_clear_screen((Vec4){0.1f, 0.1f, 0.1f});
+
+        int i;
+        for (i = 0; i < MAX_QUADS; i++)
+        {
+            float x = (float)(i % 100) * 8 + 4;
+            float y = (float)(i / 100) * 6 + 3;
+            batch_add_quad(batch, (Vec2){x, y}, (Vec2){6, 4}, (Vec4){x / 800.0f, y / 600.0f, 1, 1});
+        }
+
+        shader_upload_matrix(shader, "uProjection", projection);
+        shader_use(shader);
+        graphics_draw_batch_quads(batch);
+
+        window_swap_buffers();
+    }
+
+    printf("Fence waits: %u\n", batch_get_stats(batch).fence_waits);
+
+    batch_destroy(batch);
+    window_destroy();
+}
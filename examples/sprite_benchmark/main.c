@@ -0,0 +1,97 @@
+#include <shlib/shlib.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_SPRITES 100000
+#define FRAMES 120
+
+const char *quad_vert_src = "#version 400 core\n"
+                         "\n"
+                         "layout (location = 0) in vec3 aPosition;\n"
+                         "layout (location = 1) in vec4 aColor;\n"
+                         "\n"
+                         "uniform mat4 uProjection;\n"
+                         "\n"
+                         "out vec4 fColor;\n"
+                         "\n"
+                         "void main()\n"
+                         "{\n"
+                         "    fColor = aColor;\n"
+                         "    gl_Position = uProjection * vec4(aPosition, 1);\n"
+                         "}";
+const char *quad_frag_src = "#version 400 core\n"
+                           "\n"
+                           "in vec4 fColor;\n"
+                           "\n"
+                           "out vec4 oColor;\n"
+                           "\n"
+                           "void main()\n"
+                           "{\n"
+                           "    oColor = fColor;\n"
+                           "}";
+
+int main()
+{
+    window_init(800, 600, "Example 8 - Sprite Benchmark");
+    Batch *batch = batch_create(MAX_SPRITES);
+    Shader *shader = shader_load(quad_vert_src, quad_frag_src);
+    Matrix projection = matrix_ortho(0, 800, 600, 0, -1.0f, 1.0f);
+
+    Vec2 *positions = malloc(MAX_SPRITES * sizeof(Vec2));
+    Vec2 *sizes = malloc(MAX_SPRITES * sizeof(Vec2));
+    Vec4 *colors = malloc(MAX_SPRITES * sizeof(Vec4));
+
+    int i;
+    for (i = 0; i < MAX_SPRITES; i++)
+    {
+        positions[i] = (Vec2){(float)(rand() % 800), (float)(rand() % 600)};
+        sizes[i] = (Vec2){4, 4};
+        colors[i] = (Vec4){positions[i].x / 800.0f, positions[i].y / 600.0f, 1, 1};
+    }
+
+    // Alternate between one call per sprite and one call for all of them,
+    // timing only the vertex generation
+    double single_time = 0, bulk_time = 0;
+    int frame = 0;
+
+    while(!window_should_close())
+    {
+        window_poll_events();
+        graphics_clear_screen((Vec4){0.1f, 0.1f, 0.1f});
+
+        double start = input_get_time();
+
+        if (frame % 2)
+        {
+            batch_add_sprites_soa(batch, MAX_SPRITES, positions, sizes, colors, NULL, NULL);
+            bulk_time += input_get_time() - start;
+        }
+        else
+        {
+            for (i = 0; i < MAX_SPRITES; i++)
+                batch_add_quad(batch, positions[i], sizes[i], colors[i]);
+            single_time += input_get_time() - start;
+        }
+
+        shader_upload_matrix(shader, "uProjection", projection);
+        shader_use(shader);
+        graphics_draw_batch_quads(batch);
+
+        window_swap_buffers();
+
+        if (++frame == 2 * FRAMES)
+        {
+            printf("batch_add_quad: %.3f ms, batch_add_sprites_soa: %.3f ms (%.1fx)\n",
+                   single_time * 1000.0 / FRAMES, bulk_time * 1000.0 / FRAMES, single_time / bulk_time);
+            single_time = bulk_time = 0;
+            frame = 0;
+        }
+    }
+
+    free(positions);
+    free(sizes);
+    free(colors);
+    shader_unload(shader);
+    batch_destroy(batch);
+    window_destroy();
+}
@@ -42,15 +42,50 @@ const char *quad_frag_src = "#version 400 core\n"
                            "    float a = texture(uTextures[int(fTexId)], fTexCoord).r;\n"
                            "    oColor = vec4(a);\n"
                            "}";
+const char *sdf_frag_src = "#version 400 core\n"
+                          "\n"
+                          "in vec4 fColor;\n"
+                          "in vec2 fTexCoord;\n"
+                          "in float fTexId;\n"
+                          "\n"
+                          "uniform sampler2D uTextures[16];\n"
+                          "uniform vec4 uOutlineColor;\n"
+                          "uniform float uOutlineWidth;\n"
+                          "uniform vec2 uShadowOffset;\n"
+                          "\n"
+                          "out vec4 oColor;\n"
+                          "\n"
+                          "void main()\n"
+                          "{\n"
+                          "    float d = texture(uTextures[int(fTexId)], fTexCoord).r;\n"
+                          "    float w = fwidth(d) * 0.5;\n"
+                          "    float fill = smoothstep(0.5 - w, 0.5 + w, d);\n"
+                          "    float outline = smoothstep(0.5 - uOutlineWidth - w, 0.5 - uOutlineWidth + w, d);\n"
+                          "    float shadow = smoothstep(0.3, 0.5, texture(uTextures[int(fTexId)], fTexCoord - uShadowOffset).r) * 0.6;\n"
+                          "    float a = outline + shadow * (1.0 - outline);\n"
+                          "    vec3 color = mix(uOutlineColor.rgb, fColor.rgb, fill);\n"
+                          "    oColor = vec4(color * outline / max(a, 0.0001), a);\n"
+                          "}";
 
 int main(int argc, char **argv)
 {
     window_init(800, 600, "Example 5 - Batch Rendering");
     Font *font = font_load_from_file("./retro.ttf", 36);
+    Font *dynamic_font = font_load_dynamic("./retro.ttf", 24, NULL);
+    Font *sdf_font = font_load_sdf("./retro.ttf", 32, NULL);
+
+    // Laid out once, every frame after the first copies its vertices in
+    TextRun *hello = text_run_create(font, "Hello World!", (Vec2){0, 0}, 36, (Vec4){1, 1, 1, 1});
     Batch *batch = batch_create(MAX_QUADS);
     Shader *shader = shader_load(quad_vert_src, quad_frag_src);
+    Batch *sdf_batch = batch_create(MAX_QUADS);
+    Shader *sdf_shader = shader_load(quad_vert_src, sdf_frag_src);
     int samplers[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
     shader_upload_int_array(shader, "uTextures", 16, samplers);
+    shader_upload_int_array(sdf_shader, "uTextures", 16, samplers);
+    shader_upload_vec4(sdf_shader, "uOutlineColor", (Vec4){0, 0, 0, 1});
+    shader_upload_float(sdf_shader, "uOutlineWidth", 0.15f);
+    shader_upload_vec2(sdf_shader, "uShadowOffset", (Vec2){0.004f, 0.004f});
     Matrix projection = matrix_ortho(-400, 400, 300, -300, -1.0f, 1.0f);
 
     while(!window_should_close())
@@ -58,13 +93,32 @@ int main(int argc, char **argv)
         window_poll_events();
         graphics_clear_screen((Vec4){0.1f, 0.1f, 0.1f});
 
-        batch_add_text(batch, (Vec2){0, 0}, font, "Hello World!");
+        batch_add_text_run(batch, hello);
+        batch_add_text(batch, (Vec2){0, -60}, dynamic_font, "Caf\xc3\xa9 5\xe2\x82\xac");
+        batch_add_text_wrapped(batch, (Vec2){80, 220}, dynamic_font,
+                               "Long labels wrap at spaces to fit their box and get an ellipsis once they run out of lines",
+                               24, (Vec4){0.8f, 0.8f, 0.8f, 1}, 300, 3);
+
+        // One SDF atlas, three sizes
+        batch_add_text_scaled(sdf_batch, (Vec2){-380, 200}, sdf_font, "Small", 16, (Vec4){1, 1, 1, 1});
+        batch_add_text_scaled(sdf_batch, (Vec2){-380, 140}, sdf_font, "Medium", 48, (Vec4){1, 0.8f, 0.2f, 1});
+        batch_add_text_scaled(sdf_batch, (Vec2){-380, -200}, sdf_font, "Large", 120, (Vec4){0.3f, 0.7f, 1, 1});
 
         shader_upload_matrix(shader, "uProjection", projection);
         shader_use(shader);
         graphics_draw_batch_quads(batch);
+
+        shader_upload_matrix(sdf_shader, "uProjection", projection);
+        shader_use(sdf_shader);
+        graphics_draw_batch_quads(sdf_batch);
+
         window_swap_buffers();
     }
+    text_run_destroy(hello);
+    font_unload(sdf_font);
+    font_unload(dynamic_font);
+    font_unload(font);
+    batch_destroy(sdf_batch);
     batch_destroy(batch);
     window_destroy();
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ extern "C"{
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct Vec2
 {
@@ -37,6 +38,23 @@ typedef struct Matrix
 } Matrix;
 
 
+/*
+ * A 2D affine transform, row major like Matrix:
+ * x' = m00 * x + m01 * y + m02 and y' = m10 * x + m11 * y + m12
+ */
+typedef struct Transform2D
+{
+    float m00, m01, m02;
+    float m10, m11, m12;
+} Transform2D;
+
+typedef struct BatchVertex
+{
+    Vec2 position;
+    Vec2 tex_coord;
+    Vec4 color;
+} BatchVertex;
+
 typedef struct QuadVertex
 {
     Vec3 position;
@@ -45,12 +63,79 @@ typedef struct QuadVertex
     float tex_id;
 } QuadVertex;
 
+/*
+ * One sprite of an instanced batch. The vertex shader expands it to a quad
+ * from gl_VertexID: locations 0-5 are center, half_size, rotation, color
+ * (normalized), tex_rect (normalized u0, v0, u1, v1) and tex_id (integer).
+ */
+typedef struct QuadInstance
+{
+    Vec2 center;
+    Vec2 half_size;
+    float rotation;
+    unsigned char color[4];
+    unsigned short tex_rect[4];
+    unsigned int tex_id;
+} QuadInstance;
+
+/*
+ * Lines use locations 0-2: position, color and edge (the distance across
+ * the line from its center, the half width the quad reaches out to and the
+ * distances from either faded end). Coverage is clamp(edge.y - abs(edge.x))
+ * times clamp(min(edge.z, edge.w)), as the fade is one unit wide.
+ */
 typedef struct LineVertex
 {
     Vec3 position;
     Vec4 color;
+    Vec4 edge;
 } LineVertex;
 
+/*
+ * Shapes use locations 0-4: position, color, local (the offset from the
+ * shape's center before any transform), shape (half width, half height,
+ * corner or outer radius, outline thickness with 0 filled) and arc (the
+ * angle the arc is centered on and half its sweep, 0 for boxes).
+ */
+typedef struct ShapeVertex
+{
+    Vec3 position;
+    Vec4 color;
+    Vec2 local;
+    Vec4 shape;
+    Vec2 arc;
+} ShapeVertex;
+
+/*
+ * Vertex layouts used by batches created with BATCH_COMPACT. Quads use
+ * locations 0-4: position, color (normalized), tex_coord (normalized),
+ * tex_id (integer) and depth (normalized to [-1, 1]).
+ */
+typedef struct CompactQuadVertex
+{
+    Vec2 position;
+    unsigned char color[4];
+    unsigned short tex_coord[2];
+    unsigned short tex_id;
+    short depth;
+} CompactQuadVertex;
+
+typedef struct CompactLineVertex
+{
+    Vec2 position;
+    unsigned char color[4];
+    Vec4 edge;
+} CompactLineVertex;
+
+/*
+ * A line quad before it's transformed and colored, see LineVertex for edges
+ */
+typedef struct LineQuad
+{
+    Vec2 points[4];
+    Vec4 edges[4];
+} LineQuad;
+
 typedef struct Vertex3D
 {
     Vec3 position;
@@ -70,6 +155,12 @@ typedef struct Texture
     unsigned int channels;
 
     unsigned int id;
+    unsigned int target;
+
+    struct Texture *array;
+    unsigned int layer;
+    unsigned long long handle;
+    bool opaque;
 } Texture;
 
 typedef struct Mesh
@@ -85,43 +176,475 @@ typedef struct Mesh
     unsigned int ebo;
 } Mesh;
 
-typedef struct Batch
+#define BATCH_MAX_FRAMES_IN_FLIGHT 8
+
+/*
+ * BATCH_TEXTURE_ARRAYS copies each texture once into a shared
+ * GL_TEXTURE_2D_ARRAY of same sized textures and binds the arrays instead,
+ * so tex_id becomes (slot << 8) | layer. BATCH_BINDLESS uses
+ * ARB_bindless_texture when available: tex_id then indexes an RG32UI buffer
+ * texture of handles bound to unit 0, and the number of textures per draw is
+ * unbounded. Without the extension it falls back to BATCH_TEXTURE_ARRAYS.
+ *
+ * BATCH_DEFERRED records sprites and quads instead of writing them out. At
+ * draw time they are radix sorted by layer, blend mode, texture and then
+ * depth (back to front), with ties kept in submission order.
+ *
+ * BATCH_DEPTH_PASSES implies BATCH_DEFERRED and lets the depth buffer do
+ * the overdraw rejection. Sprites with an opaque texture and a color alpha
+ * of 1 are drawn first, front to back with blending off. Everything else
+ * is drawn after, back to front with depth writes off. Both passes order
+ * by depth and then layer, so give overlapping sprites different depths.
+ * Triangles, polygons and path fills aren't sorted and always go in the
+ * translucent pass, ahead of the sorted translucent sprites.
+ *
+ * BATCH_PREMULTIPLIED_ALPHA draws alpha, additive and premultiplied quads
+ * with the one premultiplied blend state, so they can share draws. Quad
+ * colors are premultiplied on the CPU (additive ones with their alpha
+ * zeroed), which needs textures with premultiplied alpha. Lines and
+ * shapes keep their own blend modes, and quads from batch recorders are
+ * written with their colors as given.
+ */
+typedef enum BatchFlags
+{
+    BATCH_STREAMING = 1 << 0,
+    BATCH_INSTANCED = 1 << 1,
+    BATCH_COMPACT = 1 << 2,
+    BATCH_TEXTURE_ARRAYS = 1 << 3,
+    BATCH_BINDLESS = 1 << 4,
+    BATCH_DEFERRED = 1 << 5,
+    BATCH_DEPTH_PASSES = 1 << 6,
+    BATCH_PREMULTIPLIED_ALPHA = 1 << 7,
+} BatchFlags;
+
+typedef enum LineJoin
+{
+    LINE_JOIN_MITER = 0,
+    LINE_JOIN_BEVEL,
+    LINE_JOIN_ROUND,
+} LineJoin;
+
+typedef enum LineCap
+{
+    LINE_CAP_BUTT = 0,
+    LINE_CAP_SQUARE,
+    LINE_CAP_ROUND,
+} LineCap;
+
+typedef enum BlendMode
+{
+    BLEND_ALPHA = 0,
+    BLEND_PREMULTIPLIED,
+    BLEND_ADDITIVE,
+    BLEND_MULTIPLY,
+} BlendMode;
+
+#define BATCH_MAX_TEXTURES 16
+#define BATCH_MAX_BINDLESS_TEXTURES 65536
+#define TEXTURE_ARRAY_MAX_LAYERS 256
+
+typedef struct BatchTextureEntry
+{
+    unsigned int key;
+    unsigned int slot;
+    unsigned int generation;
+} BatchTextureEntry;
+
+typedef struct BatchOptions
 {
     unsigned int max_elements;
+    unsigned int flags;
+    unsigned int frames_in_flight;
+} BatchOptions;
+
+typedef struct BatchStats
+{
+    unsigned int fence_waits;
+    double fence_wait_time;
+
+    unsigned int draw_calls;
+    unsigned int splits;
+    unsigned int dropped;
+    unsigned int clipped;
+} BatchStats;
+
+typedef struct BatchDraw
+{
+    unsigned int offset;
+    unsigned int count;
+    unsigned int texture_base;
+    Vec4 clip;
+    BlendMode blend;
+} BatchDraw;
+
+typedef struct BatchCommand
+{
+    Transform2D transform;
+    Vec2 uv[4];
+    Vec4 color;
+    float depth;
+    Vec4 clip;
+    BlendMode blend;
+    Texture *texture;
+} BatchCommand;
+
+typedef struct BatchSortEntry
+{
+    unsigned long long key;
+    unsigned int index;
+} BatchSortEntry;
+
+typedef struct BatchRecorder
+{
+    struct Batch *batch;
+
+    void *quad_data;
     unsigned int num_quads;
-    unsigned int num_lines;
+    unsigned int quad_capacity;
+    unsigned int *texture_indices;
 
-    QuadVertex *quad_vertices;
-    unsigned int *quad_indices;
+    Texture **textures;
+    unsigned int num_textures, max_textures;
+    Texture *last_texture;
+    unsigned int last_index;
+
+    float depth;
+} BatchRecorder;
+
+typedef struct StreamBuffer
+{
+    unsigned int buffer;
+    unsigned int region_size;
+    unsigned int num_regions;
+    unsigned int region;
+    unsigned int first;
+    bool persistent;
 
-    LineVertex *line_vertices;
+    unsigned char *mapped;
+    void *fences[BATCH_MAX_FRAMES_IN_FLIGHT];
+} StreamBuffer;
+
+/*
+ * Everything one kind of element (quads, lines or shapes) keeps apart: the
+ * client side vertices, counted in elements of four vertices, the draws
+ * closed so far and the GL objects they're drawn from.
+ */
+typedef struct BatchStream
+{
+    void *data;
+    unsigned int size;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int buffer_capacity;
+    unsigned int offset;
+
+    BatchDraw *draws;
+    unsigned int num_draws, max_draws;
+    unsigned int draw_start;
+
+    unsigned int vao, vbo;
+    StreamBuffer stream;
+} BatchStream;
+
+typedef struct TextLine
+{
+    unsigned int start;
+    unsigned int length;
+    float width;
+    bool ellipsis;
+} TextLine;
+
+typedef struct TextRunGlyph
+{
+    Vec2 position;
+    Vec2 size;
+    Vec2 uv[4];
+    int shelf;
+} TextRunGlyph;
+
+typedef struct Batch
+{
+    unsigned int max_elements;
+    unsigned int max_draw_elements;
+    unsigned int flags;
+
+    BatchStream quads, lines, shapes;
 
     Texture **textures;
     unsigned int num_textures;
-
-    unsigned int quad_vao, line_vao;
-    unsigned int quad_vbo, line_vbo;
-    unsigned int quad_ebo;
+    unsigned int max_textures;
+    unsigned int texture_base;
+    unsigned int texture_capacity;
+    Texture *white;
+    unsigned int white_id;
+
+    BatchTextureEntry *texture_map;
+    unsigned int texture_map_size;
+    unsigned int texture_generation;
+    Texture *last_texture;
+    unsigned int last_slot;
+
+    unsigned long long *handles;
+    unsigned int handle_buffer, handle_texture;
+
+    unsigned int layer;
+    float depth;
+    BlendMode blend;
+
+    LineJoin line_join;
+    LineCap line_cap;
+
+    Transform2D transform;
+    Transform2D *transform_stack;
+    unsigned int num_transforms, max_transforms;
+    bool transformed;
+
+    Vec4 clip;
+    Vec4 *clip_stack;
+    unsigned int num_clips, max_clips;
+
+    unsigned int *polygon_indices;
+    unsigned int max_polygon_indices;
+    TextRunGlyph *text_glyphs;
+    unsigned int max_text_glyphs;
+    TextLine *text_lines;
+    unsigned int max_text_lines;
+    LineQuad *line_quads;
+    unsigned int max_line_quads;
+
+    BatchCommand *commands;
+    BatchSortEntry *sort_entries, *sort_scratch;
+    unsigned int num_commands, max_commands;
+    unsigned int opaque_start, opaque_end;
+
+    BatchRecorder *recorders;
+    unsigned int num_recorders, max_recorders;
+    bool recording;
+
+    BatchStats stats;
+    bool frozen;
+    bool cached_glyphs;
+    float *frozen_depths;
 } Batch;
 
+typedef struct SceneSprite
+{
+    Vec2 position;
+    Vec2 size;
+    Vec4 uv_rect;
+    Vec4 color;
+    Texture *texture;
+
+    int node;
+    int prev, next;
+} SceneSprite;
+
+typedef struct SceneStats
+{
+    unsigned int drawn;
+    unsigned int culled;
+    unsigned int nodes_visited;
+} SceneStats;
+
+typedef struct Scene
+{
+    Vec2 min, max;
+    unsigned int depth;
+
+    int *heads;
+    unsigned int *counts;
+    unsigned int num_nodes;
+    int outside;
+
+    SceneSprite *sprites;
+    unsigned int num_sprites, max_sprites;
+    int free_list;
+
+    SceneStats stats;
+} Scene;
+
+typedef enum PathCommand
+{
+    PATH_MOVE_TO = 0,
+    PATH_LINE_TO,
+    PATH_QUAD_TO,
+    PATH_CUBIC_TO,
+    PATH_CLOSE,
+} PathCommand;
+
+typedef struct PathContour
+{
+    unsigned int first;
+    unsigned int count;
+    bool closed;
+} PathContour;
+
+typedef struct Path
+{
+    unsigned char *commands;
+    unsigned int num_commands, max_commands;
+    Vec2 *points;
+    unsigned int num_points, max_points;
+
+    Vec2 *flat;
+    unsigned int num_flat, max_flat;
+    PathContour *contours;
+    unsigned int num_contours, max_contours;
+    unsigned int *fill_quads;
+    unsigned int num_fill_quads, max_fill_quads;
+    LineQuad *stroke_quads;
+    unsigned int num_stroke_quads, max_stroke_quads;
+    float stroke_width;
+    LineJoin stroke_join;
+    LineCap stroke_cap;
+    unsigned int *scratch;
+    unsigned int max_scratch;
+
+    int bucket;
+    bool dirty;
+    bool filled;
+    bool stroked;
+} Path;
+
 typedef struct Framebuffer
 {
     unsigned int id;
     Texture *texture;
 } Framebuffer;
 
+/*
+ * Latin-1 advances and kerning pairs are precomputed for every font
+ */
+#define FONT_ADVANCE_TABLE_SIZE 256
+
+typedef struct FontKerningPair
+{
+    unsigned int key;
+    float advance;
+} FontKerningPair;
+
+/*
+ * Laid out like stbtt_packedchar, xoff2 and yoff2 size the quad when oversampled
+ */
 typedef struct Character
 {
     unsigned short x0, y0, x1, y1;
     float xoff, yoff, xadvance;
+    float xoff2, yoff2;
 } Character;
 
+typedef struct FontRange
+{
+    unsigned int first;
+    unsigned int count;
+} FontRange;
+
+typedef struct GlyphCacheEntry
+{
+    const struct Font *font;
+    unsigned int codepoint;
+
+    unsigned short x, y, width, height;
+    float xoff, yoff, xadvance;
+
+    int shelf;
+    int next;
+} GlyphCacheEntry;
+
+typedef struct GlyphShelf
+{
+    unsigned int y, height;
+    unsigned int used;
+    unsigned int last_used;
+    unsigned int frame;
+} GlyphShelf;
+
+typedef struct GlyphCacheStats
+{
+    unsigned int hits;
+    unsigned int rasterized;
+    unsigned int evicted;
+    unsigned int dropped;
+} GlyphCacheStats;
+
+typedef struct GlyphCache
+{
+    Texture *texture;
+
+    GlyphShelf *shelves;
+    unsigned int num_shelves, max_shelves;
+    unsigned int top;
+
+    GlyphCacheEntry *entries;
+    unsigned int num_entries, max_entries;
+    int free_list;
+    int *buckets;
+    unsigned int num_buckets;
+    unsigned int num_glyphs;
+
+    unsigned char *pixels;
+    unsigned int max_pixels;
+
+    unsigned int tick;
+    unsigned int generation;
+    GlyphCacheStats stats;
+} GlyphCache;
+
 typedef struct Font
 {
     Texture *bitmap;
-    Character character_data[96];
+    Character *character_data;
+    FontRange *ranges;
+    unsigned int num_ranges;
+    unsigned int oversample_x, oversample_y;
+
+    GlyphCache *cache;
+    bool owns_cache;
+    void *info;
+    unsigned char *data;
+    float size;
+    float scale;
+    bool sdf;
+
+    float ascent, descent, line_gap;
+    float advances[FONT_ADVANCE_TABLE_SIZE];
+    FontKerningPair *kerning;
+    unsigned int kerning_mask;
 } Font;
 
+typedef struct TextRun
+{
+    Font *font;
+    char *text;
+    Vec2 position;
+    float size;
+    Vec4 color;
+
+    TextRunGlyph *glyphs;
+    unsigned int num_glyphs, max_glyphs;
+    int *shelves;
+    unsigned int num_shelves, max_shelves;
+    unsigned int generation;
+
+    void *vertices;
+    unsigned int vertex_format;
+    float vertex_depth;
+    int vertex_slot;
+    bool has_vertices;
+
+    unsigned int hash;
+    unsigned int last_frame;
+    struct TextRun *next;
+} TextRun;
+
+typedef struct TextRunCache
+{
+    TextRun **buckets;
+    unsigned int num_buckets;
+    unsigned int num_runs;
+    unsigned int frame;
+} TextRunCache;
+
 
 typedef enum MouseButtons
 {
@@ -227,6 +750,17 @@ extern char *utils_read_file(const char *path);
  */
 extern unsigned char *utils_read_file_bytes(const char *path);
 
+/*
+ * Reads the given file in bytes and stores how many there were in length
+ */
+extern unsigned char *utils_read_file_sized(const char *path, size_t *length);
+
+/*
+ * Returns the code point at *text and moves it past it. Malformed bytes
+ * come out as U+FFFD one at a time.
+ */
+extern unsigned int utils_utf8_decode(const char **text);
+
 /*********************************************************
  *                     INPUT FUNCTIONS                   *
  *********************************************************/
@@ -243,6 +777,7 @@ extern double input_get_time();
 extern void graphics_clear_screen(Vec4 color);
 extern void graphics_draw_batch_quads(Batch *batch);
 extern void graphics_draw_batch_lines(Batch *batch);
+extern void graphics_draw_batch_shapes(Batch *batch);
 extern void graphics_draw_mesh(Mesh *mesh);
 
 /*********************************************************
@@ -268,27 +803,382 @@ extern void shader_upload_matrix(Shader *shader, const char *name, Matrix value)
 extern Texture *texture_load_from_file(const char *path);
 extern Texture *texture_load(void *data, int width, int height, int channels);
 extern void texture_unload(Texture *texture);
+
+/*
+ * Textures loaded with 3 channels, or 4 with every alpha at 255, are
+ * marked opaque. This overrides that, e.g. for a texture updated later.
+ */
+extern void texture_set_opaque(Texture *texture, bool opaque);
 extern void texture_use(Texture *texture, int slot);
 
 /*********************************************************
  *                     BATCH FUNCTIONS                   *
  *********************************************************/
 
+/*
+ * Creates a batch sized for max_elements quads and lines per draw (at most
+ * 16384, the most a 16-bit index can reach). Adding more than that (or
+ * more textures than there are slots) splits the batch into several draws
+ * instead of dropping primitives. A max_elements of 0 is taken as 1.
+ */
 extern Batch *batch_create(unsigned int max_elements);
+
+/*
+ * Creates a batch with extra options. With BATCH_STREAMING the vertices are
+ * written straight into a persistently mapped buffer split into
+ * frames_in_flight regions (3 when left at 0), each guarded by a fence.
+ */
+extern Batch *batch_create_with_options(BatchOptions options);
+
 extern void batch_destroy(Batch *batch);
 extern void batch_add_sprite(Batch *batch, Vec2 position, Vec2 size, Texture *texture);
 extern void batch_add_sprite_uv(Batch *batch, Vec2 position, Vec2 size, Vec2 uv[4], Texture *texture);
 extern void batch_add_text(Batch *batch, Vec2 position, Font *font, const char *text);
+
+/*
+ * Draws text size pixels tall, whatever size the font was loaded at, and
+ * tinted by color. Scaled bitmap fonts blur, SDF fonts stay sharp.
+ */
+extern void batch_add_text_scaled(Batch *batch, Vec2 position, Font *font, const char *text, float size, Vec4 color);
 extern void batch_add_quad(Batch *batch, Vec2 position, Vec2 size, Vec4 color);
+
+/*
+ * Rotated sprites and quads turn by rotation radians (counter clockwise)
+ * around pivot, given relative to their center in the same units as size.
+ * A transformed sprite is the unit square centered on the origin mapped
+ * through transform. Instanced batches store a rotation and a size per
+ * sprite, so shear is dropped there.
+ */
+extern void batch_add_sprite_rotated(Batch *batch, Vec2 position, Vec2 size, float rotation, Vec2 pivot, Texture *texture);
+extern void batch_add_quad_rotated(Batch *batch, Vec2 position, Vec2 size, float rotation, Vec2 pivot, Vec4 color);
+extern void batch_add_sprite_transformed(Batch *batch, Transform2D transform, Vec2 uv[4], Vec4 color, Texture *texture);
+
+/*
+ * Pushes a transform that is applied on top of the current one to
+ * everything added until the matching pop.
+ */
+extern void batch_push_transform(Batch *batch, Transform2D transform);
+extern void batch_pop_transform(Batch *batch);
+
+/*
+ * Pushes a clip rect, given by its top left corner and size, that is
+ * intersected with the current one. Clip rects are in the coordinates the
+ * batch ends up in after its transforms, taken to be window pixels with y
+ * pointing down as with matrix_ortho(0, width, 0, height, ...), since the
+ * scissor box is placed by flipping the rect from the top of the viewport.
+ * With a y up projection the CPU test and the scissor disagree. Anything
+ * fully outside is dropped on the CPU (counted in clipped) and the rest is
+ * cut with glScissor. Draws only split when the clip actually changes.
+ * Deferred batches keep each quad's clip through sorting, and recorded
+ * quads take the clip active at batch_end_parallel.
+ */
+extern void batch_push_clip(Batch *batch, Vec2 position, Vec2 size);
+extern void batch_pop_clip(Batch *batch);
+
+/*
+ * Adds count sprites from separate arrays in one call. colors, uv_rects
+ * (u0, v0, u1, v1 from the bottom left to the top right corner) and
+ * textures can be NULL for white, the whole texture and no texture. The
+ * float vertex layout is generated with SSE2 when the compiler targets it.
+ */
+extern void batch_add_sprites_soa(Batch *batch, unsigned int count, const Vec2 *positions, const Vec2 *sizes, const Vec4 *colors, const Vec4 *uv_rects, Texture **textures);
+
+/*
+ * Adds triangles that share the quads' buffer and draws, two to a quad
+ * slot when they share an edge (a fan does) and one otherwise. indices
+ * (three per triangle) can be NULL to take the vertices in order, and
+ * triangles pointing past num_vertices are skipped. batch_add_polygon
+ * triangulates a simple polygon of either winding by ear clipping.
+ * Instanced batches can't hold triangles, and deferred batches write them
+ * straight away instead of sorting them with the sprites.
+ */
+extern void batch_add_triangles(Batch *batch, const BatchVertex *vertices, unsigned int num_vertices, const unsigned int *indices, unsigned int num_indices, Texture *texture);
+extern void batch_add_convex_polygon(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color);
+extern void batch_add_polygon(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color);
+
+/*
+ * Lines are expanded into one quad per segment with a one unit wide faded
+ * edge for anti-aliasing, so any width works and nothing depends on
+ * glLineWidth. The line shader turns the edge attribute into coverage (see
+ * the LineVertex layout and the batch_rendering example). Butt and square
+ * caps stretch the end segments, round caps and non-miter joins add a fan
+ * that doesn't overlap them, so translucent lines blend once. Polylines
+ * share their joins, and closed ones also join the last point to the first.
+ */
 extern void batch_add_line(Batch *batch, Vec2 start, Vec2 end, Vec4 color, float width);
+extern void batch_add_polyline(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color, float width, bool closed);
+
+/*
+ * Shapes are one quad each, drawn with graphics_draw_batch_shapes and a
+ * shader that evaluates their signed distance per fragment (see the
+ * ShapeVertex layout and the batch_rendering example). Rounded rects are
+ * positioned by their center like sprites. Arcs cover start_angle to
+ * end_angle in radians, or a pie slice with no thickness. Rings and arcs
+ * keep their thickness inside the radius.
+ */
+extern void batch_add_circle(Batch *batch, Vec2 center, float radius, Vec4 color);
+extern void batch_add_rounded_rect(Batch *batch, Vec2 position, Vec2 size, float radius, Vec4 color);
+extern void batch_add_ring(Batch *batch, Vec2 center, float radius, float thickness, Vec4 color);
+extern void batch_add_arc(Batch *batch, Vec2 center, float radius, float thickness, float start_angle, float end_angle, Vec4 color);
+extern void batch_set_line_style(Batch *batch, LineJoin join, LineCap cap);
+
+/*
+ * Uploads everything added so far to a static buffer and frees the client
+ * side copy. A frozen batch is drawn as is every frame and ignores further
+ * adds, but single quads can be patched in place with batch_update_quad
+ * (the texture has to be one the quad's draw already uses). Not available
+ * for streaming batches.
+ *
+ * batch_update_quad takes position and size as they end up on screen: the
+ * transform stack is ignored, and the quad keeps the depth it was added
+ * with whatever batch_set_depth says now. Its color is premultiplied like
+ * any added quad's, for the blend mode currently set. Draws aren't sorted
+ * again, so a quad made translucent in a depth pass batch still draws as
+ * opaque.
+ *
+ * Fails as well once the batch holds text from a glyph cache (fonts loaded
+ * with font_load_dynamic or font_load_sdf). Those glyphs can be evicted
+ * and their atlas space reused, and a frozen batch would keep drawing
+ * whatever took their place. Draw such text from a batch that is rebuilt
+ * every frame, or use a baked font.
+ */
+extern bool batch_freeze(Batch *batch);
+extern bool batch_update_quad(Batch *batch, unsigned int index, Vec2 position, Vec2 size, Vec2 uv[4], Vec4 color, Texture *texture);
+
+/*
+ * Splits recording across threads. batch_begin_parallel (on the GL thread)
+ * hands out num_recorders recorders, and each worker fills its own with the
+ * batch_recorder_* calls without locking. batch_end_parallel, or the next
+ * graphics_draw_batch_quads, appends them in index order, so the result
+ * doesn't depend on thread timing. Recorders write the batch's own vertex
+ * layout and ignore its transform stack. Deferred batches and batches with
+ * depth passes get no recorders: batch_get_recorder returns NULL for them.
+ */
+extern void batch_begin_parallel(Batch *batch, unsigned int num_recorders);
+extern BatchRecorder *batch_get_recorder(Batch *batch, unsigned int index);
+extern void batch_end_parallel(Batch *batch);
+extern void batch_recorder_add_sprite(BatchRecorder *recorder, Vec2 position, Vec2 size, Texture *texture);
+extern void batch_recorder_add_sprite_uv(BatchRecorder *recorder, Vec2 position, Vec2 size, Vec2 uv[4], Texture *texture);
+extern void batch_recorder_add_quad(BatchRecorder *recorder, Vec2 position, Vec2 size, Vec4 color);
+extern void batch_recorder_add_sprite_transformed(BatchRecorder *recorder, Transform2D transform, Vec2 uv[4], Vec4 color, Texture *texture);
+extern void batch_recorder_set_depth(BatchRecorder *recorder, float depth);
+
+/*
+ * Sets the layer (0-255, drawn in ascending order) and depth (-1 to 1,
+ * larger is nearer) of the quads added afterwards.
+ */
+extern void batch_set_layer(Batch *batch, unsigned int layer);
+extern void batch_set_depth(Batch *batch, float depth);
+
+/*
+ * Sets the blend mode of everything added afterwards. Draws split where
+ * the mode changes, and deferred batches group quads by mode within a
+ * layer. BLEND_MULTIPLY multiplies the destination by the source color
+ * and fades back to the destination as source alpha falls, so it expects
+ * premultiplied output: quad colors are premultiplied for you, textures
+ * should be premultiplied too (any with rgb 0 where alpha is 0 are fine),
+ * and shaders that compute their own coverage should scale rgb with it.
+ */
+extern void batch_set_blend_mode(Batch *batch, BlendMode mode);
+
+/*
+ * Returns the counters gathered since the last reset. A growing fence_waits
+ * means a streaming batch had to wait for the GPU to release a region, and
+ * splits counts the extra draws caused by running out of room or texture
+ * slots. Streaming batches only drop primitives (counted in dropped) once
+ * every region of the ring is used by the same submission. Primitives
+ * dropped for being outside the clip rect are counted in clipped.
+ */
+extern BatchStats batch_get_stats(Batch *batch);
+extern void batch_reset_stats(Batch *batch);
+
+/*********************************************************
+ *                     SCENE FUNCTIONS                   *
+ *********************************************************/
+
+/*
+ * A retained set of sprites kept in a loose quadtree over the min to max
+ * rectangle, depth levels deep (at most 10). Sprites outside of it still
+ * work, they just always get tested. scene_draw adds only the sprites
+ * that overlap the rectangle an orthographic projection shows; the
+ * batch's transform stack isn't taken into account for culling.
+ * scene_update_sprite only moves a sprite between nodes when it leaves
+ * its current one. Ids stay valid until the sprite is removed.
+ */
+extern Scene *scene_create(Vec2 min, Vec2 max, unsigned int depth);
+extern void scene_destroy(Scene *scene);
+extern unsigned int scene_add_sprite(Scene *scene, Vec2 position, Vec2 size, Vec4 color, Texture *texture);
+extern void scene_set_sprite_uv(Scene *scene, unsigned int id, Vec4 uv_rect);
+extern void scene_update_sprite(Scene *scene, unsigned int id, Vec2 position, Vec2 size);
+extern void scene_remove_sprite(Scene *scene, unsigned int id);
+extern void scene_draw(Scene *scene, Batch *batch, Matrix projection);
+
+/*
+ * Returns how many sprites the last scene_draw added and how many it culled
+ */
+extern SceneStats scene_get_stats(Scene *scene);
+
+/*********************************************************
+ *                     PATH FUNCTIONS                    *
+ *********************************************************/
+
+/*
+ * A vector path built from lines, quadratic and cubic Beziers. Curves are
+ * flattened finely enough to stay within a quarter pixel at the scale the
+ * batch's transform draws them at, and the flattened points and fill
+ * triangles are kept on the path. They're only rebuilt after the path is
+ * edited or the transform's scale moves to another half octave, so
+ * drawing the same path every frame costs about as much as a polygon.
+ * path_close joins the contour back to its start, and drawing after it
+ * without a path_move_to begins a new contour from that start.
+ */
+extern Path *path_create(void);
+extern void path_destroy(Path *path);
+extern void path_clear(Path *path);
+extern void path_move_to(Path *path, Vec2 point);
+extern void path_line_to(Path *path, Vec2 point);
+extern void path_quad_to(Path *path, Vec2 control, Vec2 point);
+extern void path_cubic_to(Path *path, Vec2 control1, Vec2 control2, Vec2 point);
+extern void path_close(Path *path);
+
+/*
+ * Fills every contour as a closed polygon, whether it was closed or not.
+ * Contours are filled on their own, so one inside another covers it
+ * instead of cutting a hole. Self intersecting contours fill, but not
+ * with either fill rule.
+ */
+extern void batch_fill_path(Batch *batch, Path *path, Vec4 color);
+
+/*
+ * Strokes every contour the way batch_add_polyline does, with the batch's
+ * line style. The expanded quads are kept on the path and reused until it
+ * changes, its scale bucket changes or it's stroked with another width or
+ * style, so alternating styles on one path rebuilds every time.
+ */
+extern void batch_stroke_path(Batch *batch, Path *path, Vec4 color, float width);
+
+/*********************************************************
+ *                     TEXT FUNCTIONS                    *
+ *********************************************************/
+
+/*
+ * A string laid out once, for labels that don't change between frames.
+ * The first time a run is added to a batch its glyphs are written out in
+ * that batch's vertex format, and after that adding it is a single copy
+ * while the format, depth and texture slot stay the same. Batches that
+ * sort, transform or clip still get the laid out glyphs one quad at a
+ * time. Runs of dynamic fonts lay themselves out again once the glyph
+ * cache has evicted anything. Destroy runs before their font.
+ */
+extern TextRun *text_run_create(Font *font, const char *text, Vec2 position, float size, Vec4 color);
+extern void text_run_destroy(TextRun *run);
+extern void batch_add_text_run(Batch *batch, TextRun *run);
+
+/*
+ * Keeps a text run for every distinct font, string, position, size and
+ * color drawn through batch_add_text_cached, and frees the ones that
+ * haven't been drawn in 60 frames. Clear it before unloading a font it
+ * has drawn.
+ */
+extern TextRunCache *text_run_cache_create(void);
+extern void text_run_cache_destroy(TextRunCache *cache);
+extern void text_run_cache_clear(TextRunCache *cache);
+extern void batch_add_text_cached(Batch *batch, TextRunCache *cache, Vec2 position, Font *font, const char *text, float size, Vec4 color);
+
+/*
+ * Width of the widest line and height from the first line's ascent to
+ * the last one's descent, for text drawn size pixels tall. Widths are
+ * summed from the advances and kerning pairs worked out when the font
+ * loaded, so measuring never rasterizes. Past Latin-1 they come from the
+ * face instead, baked fonts have nothing there.
+ */
+extern Vec2 text_measure(Font *font, const char *text, float size);
+
+/*
+ * Distance between the baselines of two lines drawn size pixels tall
+ */
+extern float font_get_line_height(Font *font, float size);
+
+/*
+ * Splits text into lines no wider than max_width, breaking after spaces
+ * or, for words too long to fit, between characters. Newlines always
+ * break. Lines leave out their trailing spaces, and indentation is dropped
+ * when the first word wouldn't fit after it. With a line_limit the last
+ * line that fits is cut short with an ellipsis when visible text remains;
+ * 0 leaves the count unlimited. The lines
+ * are written to *lines, grown as needed, and their count is returned;
+ * start and length are byte offsets into text and free the array
+ * yourself once done.
+ */
+extern unsigned int text_wrap(Font *font, const char *text, float size, float max_width, unsigned int line_limit, TextLine **lines, unsigned int *max_lines);
+
+/*
+ * Wraps text as text_wrap does and draws its lines one line height apart,
+ * starting from the baseline at position
+ */
+extern void batch_add_text_wrapped(Batch *batch, Vec2 position, Font *font, const char *text, float size, Vec4 color, float max_width, unsigned int line_limit);
 
 /*********************************************************
  *                     FONT FUNCTIONS                    *
  *********************************************************/
 
+/*
+ * Bakes printable ASCII into an atlas sized to fit, same as
+ * font_load_packed with the single range 32 to 127 and no oversampling
+ */
 extern Font *font_load_from_file(const char *path, float font_size);
+
+/*
+ * Bakes every code point in ranges into one atlas, the smallest power of
+ * two texture the glyphs pack into. Oversampling rasterizes glyphs that
+ * many times larger along each axis, up to 8, and filters them back down,
+ * which keeps small text sharp when it lands between pixels; 2x1 is
+ * usually enough. Code points the face doesn't have are left out.
+ */
+extern Font *font_load_packed(const char *path, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y);
+
+/*
+ * Loads a packed font from the atlas and metrics saved in cache_path by
+ * an earlier call, in one read and without rasterizing anything. The file
+ * is only used when it was baked from a font file with the same contents
+ * and with the same size, ranges and oversampling; otherwise the font is
+ * baked as font_load_packed does and cache_path is overwritten.
+ */
+extern Font *font_load_cached(const char *path, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y, const char *cache_path);
+
+/*
+ * Loads a font whose glyphs are rasterized the first time they're drawn
+ * and kept in the glyph cache's atlas, so text can use any code point in
+ * the face. Several fonts can share one cache; pass NULL to give the font
+ * a 512x512 cache of its own. batch_add_text decodes UTF-8 for both kinds
+ * of font, baked fonts just skip anything outside their ranges.
+ */
+extern Font *font_load_dynamic(const char *path, float font_size, GlyphCache *cache);
+
+/*
+ * Loads a dynamic font that stores signed distance fields, rasterized
+ * once at reference_size, so one atlas serves every size it's drawn at.
+ * The red channel holds the distance, 0.5 on the outline, rising inside
+ * and falling to 0 eight reference pixels outside, so shaders can
+ * threshold it and draw outlines, glows and shadows from the same texels.
+ * Keep SDF fonts in their own glyph cache, as they need their own shader.
+ */
+extern Font *font_load_sdf(const char *path, float reference_size, GlyphCache *cache);
 extern void font_unload(Font *font);
 
+/*
+ * A single channel atlas packed in shelves. When it fills up, the shelf
+ * drawn from longest ago is emptied to make room, but never one drawn
+ * from since the last window_swap_buffers, as the batch holding those
+ * glyphs may not have been drawn yet. Glyphs that can't get room then
+ * are skipped and counted in dropped. Only the texels of new glyphs are
+ * uploaded.
+ */
+extern GlyphCache *glyph_cache_create(unsigned int width, unsigned int height);
+extern void glyph_cache_destroy(GlyphCache *cache);
+extern GlyphCacheStats glyph_cache_get_stats(GlyphCache *cache);
+extern void glyph_cache_reset_stats(GlyphCache *cache);
+
 /*********************************************************
  *                 FRAMEBUFFER FUNCTIONS                 *
  *********************************************************/
@@ -320,6 +1210,15 @@ extern void vec3_print(Vec3 vector);
  *            VECTOR TRANSFORMATION FUNCTIONS            *
  *********************************************************/
 
+extern Vec2 vec2_add(Vec2 left, Vec2 right);
+extern Vec2 vec2_sub(Vec2 left, Vec2 right);
+extern float vec2_dot(Vec2 left, Vec2 right);
+extern float vec2_cross(Vec2 left, Vec2 right);
+extern Vec2 vec2_normalize(Vec2 vector);
+extern Vec2 vec2_scale(Vec2 vector, float scalar);
+extern Vec2 vec2_rotate(Vec2 vector, float radians);
+extern float vec2_magnitude(Vec2 vector);
+
 extern Vec3 vec3_add(Vec3 left, Vec3 right);
 extern Vec3 vec3_sub(Vec3 left, Vec3 right);
 extern float vec3_dot(Vec3 left, Vec3 right);
@@ -342,6 +1241,16 @@ extern Matrix matrix_scale(Matrix matrix, Vec3 scalar);
 extern Matrix matrix_rotate(Matrix matrix, Quaternion quaternion);
 extern Matrix matrix_translate(Matrix matrix, Vec3 translation);
 
+/*********************************************************
+ *                 2D TRANSFORM FUNCTIONS                *
+ *********************************************************/
+
+extern Transform2D transform2d_identity(void);
+extern Transform2D transform2d_create(Vec2 translation, float rotation, Vec2 scale);
+extern Transform2D transform2d_mul(Transform2D left, Transform2D right);
+extern Vec2 transform2d_apply(Transform2D transform, Vec2 point);
+extern bool transform2d_is_identity(Transform2D transform);
+
 /*********************************************************
  *           MATRIX PROJECTION & VIEW FUNCTIONS          *
  *********************************************************/
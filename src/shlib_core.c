@@ -8,6 +8,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -21,6 +26,7 @@
 
 Window window = { 0 };
 Input input = { 0 };
+Graphics graphics = { 0 };
 
 /*********************************************************
  *                    WINDOW FUNCTIONS                   *
@@ -56,14 +62,42 @@ void window_init(int width, int height, const char *title)
     if (!gladLoadGLLoader((GLADloadproc)&glfwGetProcAddress))
         return;
 
+    glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &graphics.max_texture_units);
+
+    // Optional entry points that are newer than the 4.0 context we ask for
+    if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+        graphics.buffer_storage = (PFNSHLIBBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+
+    if (glfwExtensionSupported("GL_ARB_bindless_texture"))
+    {
+        graphics.get_texture_handle = (PFNSHLIBGETTEXTUREHANDLEPROC)glfwGetProcAddress("glGetTextureHandleARB");
+        graphics.make_texture_handle_resident = (PFNSHLIBMAKETEXTUREHANDLERESIDENTPROC)glfwGetProcAddress("glMakeTextureHandleResidentARB");
+        graphics.make_texture_handle_non_resident = (PFNSHLIBMAKETEXTUREHANDLENONRESIDENTPROC)glfwGetProcAddress("glMakeTextureHandleNonResidentARB");
+    }
+
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_LINE_SMOOTH);
 }
 
 void window_destroy(void)
 {
+    if (graphics.quad_ebo)
+        glDeleteBuffers(1, &graphics.quad_ebo);
+
+    unsigned int i;
+    for (i = 0; i < graphics.num_texture_pools; i++)
+    {
+        glDeleteTextures(1, &graphics.texture_pools[i].array->id);
+        free(graphics.texture_pools[i].array);
+    }
+
+    free(graphics.texture_pools);
+    graphics.texture_pools = NULL;
+    graphics.num_texture_pools = 0;
+    graphics.quad_ebo = 0;
+    graphics.quad_ebo_capacity = 0;
+
     glfwDestroyWindow(window.handle);
     glfwTerminate();
 }
@@ -81,6 +115,9 @@ void window_poll_events(void)
 void window_swap_buffers(void)
 {
     glfwSwapBuffers(window.handle);
+
+    // Everything batched last frame has been drawn, so its glyphs may be evicted
+    graphics.frame++;
 }
 
 void window_toggle_fullscreen(void)
@@ -172,37 +209,211 @@ void graphics_clear_screen(Vec4 color)
 
 void graphics_draw_batch_quads(Batch *batch)
 {
-    if (!batch->num_quads)
+    if (batch->recording)
+        batch_end_parallel(batch);
+
+    if (batch->flags & BATCH_DEFERRED)
+        batch_flush_commands(batch);
+
+    batch_close_draw(batch, &batch->quads);
+
+    if (!batch->quads.num_draws)
         return;
 
-    int i;
-    for (i = 0; i < batch->num_textures; i++)
-        texture_use(batch->textures[i], i);
+    batch_upload(batch, &batch->quads);
+
+    glBindVertexArray(batch->quads.vao);
+
+    // Equal depths still draw in order, the later sprite on top
+    if (batch->flags & BATCH_DEPTH_PASSES)
+        glDepthFunc(GL_LEQUAL);
+
+    Vec4 clip = BATCH_NO_CLIP;
+    int viewport[4] = {0, 0, -1, -1};
+    BlendMode blend = BLEND_ALPHA;
+
+    unsigned int opaque = batch->opaque_start == BATCH_NO_PASS ? 0 : batch->opaque_end - batch->opaque_start;
+
+    unsigned int n, i, j, bound = ~0u;
+    for (n = 0; n < batch->quads.num_draws; n++)
+    {
+        // The opaque pass goes first, then everything else in the order it was
+        // written, so quads that skipped the commands are drawn as translucent
+        if (n < opaque)
+            i = batch->opaque_start + n;
+        else
+            i = n - opaque < batch->opaque_start ? n - opaque : n;
+
+        BatchDraw *draw = &batch->quads.draws[i];
 
-    glBindBuffer(GL_ARRAY_BUFFER, batch->quad_vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, (long)(batch->num_quads * 4 * sizeof(QuadVertex)), batch->quad_vertices);
+        graphics_apply_clip(draw->clip, &clip, viewport);
+        graphics_apply_blend(draw->blend, &blend);
+
+        if (batch->flags & BATCH_DEPTH_PASSES)
+        {
+            if (n == 0 && opaque)
+                glDisable(GL_BLEND);
+
+            // Translucent sprites are tested against the opaque ones but don't hide each other
+            if (n == opaque)
+            {
+                glEnable(GL_BLEND);
+                glDepthMask(GL_FALSE);
+            }
+        }
+
+        // Texture sets are stored back to back, so a set ends where the next one starts
+        if (draw->texture_base != bound)
+        {
+            unsigned int end = batch->texture_base + batch->num_textures;
+            for (j = i + 1; j < batch->quads.num_draws; j++)
+            {
+                if (batch->quads.draws[j].texture_base != draw->texture_base)
+                {
+                    end = batch->quads.draws[j].texture_base;
+                    break;
+                }
+            }
+
+            batch_bind_textures(batch, draw->texture_base, end);
+            bound = draw->texture_base;
+        }
+
+        if (batch->flags & BATCH_INSTANCED)
+        {
+            batch_bind_instances(batch, draw->offset);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (int)draw->count);
+        }
+        else
+        {
+            int base_vertex = (int)(draw->offset / (batch->quads.size / 4));
+            glDrawElementsBaseVertex(GL_TRIANGLES, (int)(draw->count * 6), GL_UNSIGNED_SHORT, 0, base_vertex);
+        }
+    }
 
-    glBindVertexArray(batch->quad_vao);
-    glDrawElements(GL_TRIANGLES, (int)(batch->num_quads * 6), GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
+    graphics_apply_clip(BATCH_NO_CLIP, &clip, viewport);
+    graphics_apply_blend(BLEND_ALPHA, &blend);
 
-    batch->num_quads = 0;
-    batch->num_textures = 1;
+    if (batch->flags & BATCH_DEPTH_PASSES)
+    {
+        glEnable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+
+    batch->stats.draw_calls += batch->quads.num_draws;
+    batch->stats.splits += batch->quads.num_draws - 1;
+
+    // Frozen batches keep their draws and are drawn again next frame
+    if (batch->frozen)
+        return;
+
+    batch_rewind(batch, &batch->quads);
+    batch->texture_base = 0;
+    batch->opaque_start = BATCH_NO_PASS;
+    batch->opaque_end = BATCH_NO_PASS;
+    batch->cached_glyphs = false;
+    batch_reset_textures(batch);
 }
 
 void graphics_draw_batch_lines(Batch *batch)
 {
-    if (!batch->num_lines)
+    graphics_draw_batch_stream(batch, &batch->lines);
+}
+
+void graphics_draw_batch_shapes(Batch *batch)
+{
+    graphics_draw_batch_stream(batch, &batch->shapes);
+}
+
+void graphics_draw_batch_stream(Batch *batch, BatchStream *stream)
+{
+    batch_close_draw(batch, stream);
+
+    if (!stream->num_draws)
         return;
 
-    glBindBuffer(GL_ARRAY_BUFFER, batch->line_vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, (long)(batch->num_lines * 2 * sizeof(LineVertex)), batch->line_vertices);
+    batch_upload(batch, stream);
+    glBindVertexArray(stream->vao);
+
+    Vec4 clip = BATCH_NO_CLIP;
+    int viewport[4] = {0, 0, -1, -1};
+    BlendMode blend = BLEND_ALPHA;
+
+    unsigned int i;
+    for (i = 0; i < stream->num_draws; i++)
+    {
+        BatchDraw *draw = &stream->draws[i];
+
+        graphics_apply_clip(draw->clip, &clip, viewport);
+        graphics_apply_blend(draw->blend, &blend);
+        int base_vertex = (int)(draw->offset / (stream->size / 4));
+        glDrawElementsBaseVertex(GL_TRIANGLES, (int)(draw->count * 6), GL_UNSIGNED_SHORT, 0, base_vertex);
+    }
 
-    glBindVertexArray(batch->line_vao);
-    glDrawArrays(GL_LINES, 0, (int)(batch->num_lines * 2));
     glBindVertexArray(0);
+    graphics_apply_clip(BATCH_NO_CLIP, &clip, viewport);
+    graphics_apply_blend(BLEND_ALPHA, &blend);
+
+    batch->stats.draw_calls += stream->num_draws;
+    batch->stats.splits += stream->num_draws - 1;
+
+    if (!batch->frozen)
+        batch_rewind(batch, stream);
+}
+
+void graphics_apply_clip(Vec4 clip, Vec4 *bound, int viewport[4])
+{
+    if (!memcmp(&clip, bound, sizeof(Vec4)))
+        return;
+
+    if (clip.x == -FLT_MAX)
+    {
+        glDisable(GL_SCISSOR_TEST);
+    }
+    else
+    {
+        if (bound->x == -FLT_MAX)
+            glEnable(GL_SCISSOR_TEST);
+
+        // Queried on the first clipped draw of a batch only, it stalls until GL catches up
+        if (viewport[2] < 0)
+            glGetIntegerv(GL_VIEWPORT, viewport);
+
+        // Clip rects are y down window pixels like the primitives tested against them, scissor boxes count from the bottom left
+        int left = (int)floorf(clip.x), top = (int)floorf(clip.y);
+        int right = (int)ceilf(clip.z), bottom = (int)ceilf(clip.w);
+
+        glScissor(viewport[0] + left, viewport[1] + viewport[3] - bottom, right > left ? right - left : 0, bottom > top ? bottom - top : 0);
+    }
+
+    *bound = clip;
+}
+
+void graphics_apply_blend(BlendMode mode, BlendMode *bound)
+{
+    if (mode == *bound)
+        return;
+
+    switch (mode)
+    {
+        case BLEND_ALPHA:
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            break;
+        case BLEND_PREMULTIPLIED:
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            break;
+        case BLEND_ADDITIVE:
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+            break;
+        case BLEND_MULTIPLY:
+            // Premultiplied, so where alpha is 0 the destination is left alone
+            glBlendFunc(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);
+            break;
+    }
 
-    batch->num_lines = 0;
+    *bound = mode;
 }
 
 void graphics_draw_mesh(Mesh *mesh)
@@ -212,6 +423,44 @@ void graphics_draw_mesh(Mesh *mesh)
     glBindVertexArray(0);
 }
 
+void graphics_reserve_quad_indices(unsigned int count)
+{
+    if (count <= graphics.quad_ebo_capacity)
+        return;
+
+    if (count > BATCH_MAX_DRAW_ELEMENTS)
+        count = BATCH_MAX_DRAW_ELEMENTS;
+
+    // Every batch shares this one buffer and draws slices of it with a base
+    // vertex, so it only ever grows and the CPU copy is thrown away
+    unsigned short *indices = malloc(count * 6 * sizeof(unsigned short));
+
+    unsigned int i, index = 0;
+    for (i = 0; i < count * 6; i += 6)
+    {
+        indices[i + 0] = (unsigned short)(index + 0);
+        indices[i + 1] = (unsigned short)(index + 1);
+        indices[i + 2] = (unsigned short)(index + 2);
+
+        indices[i + 3] = (unsigned short)(index + 2);
+        indices[i + 4] = (unsigned short)(index + 3);
+        indices[i + 5] = (unsigned short)(index + 0);
+
+        index += 4;
+    }
+
+    if (!graphics.quad_ebo)
+        glGenBuffers(1, &graphics.quad_ebo);
+
+    // Respecifying the same buffer keeps it attached to every existing VAO.
+    // The copy target leaves whatever VAO is bound alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, graphics.quad_ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (long)(count * 6 * sizeof(unsigned short)), indices, GL_STATIC_DRAW);
+
+    graphics.quad_ebo_capacity = count;
+    free(indices);
+}
+
 /*********************************************************
  *                    SHADER FUNCTIONS                   *
  *********************************************************/
@@ -392,10 +641,12 @@ Texture *texture_load(void *data, int width, int height, int channels)
     if (!data)
         return NULL;
 
-    Texture *result = malloc(sizeof(Texture));
+    Texture *result = calloc(1, sizeof(Texture));
     result->width = width;
     result->height = height;
     result->channels = channels;
+    result->target = GL_TEXTURE_2D;
+    result->opaque = texture_data_opaque(data, width * height, channels);
 
     glGenTextures(1, &result->id);
     glBindTexture(GL_TEXTURE_2D, result->id);
@@ -428,17 +679,179 @@ Texture *texture_load(void *data, int width, int height, int channels)
 
 void texture_unload(Texture *texture)
 {
+    if (texture->handle)
+        graphics.make_texture_handle_non_resident(texture->handle);
+
+    if (texture->array)
+        texture_array_release(texture);
+
     glDeleteTextures(1, &texture->id);
     free(texture);
 }
 
+void texture_set_opaque(Texture *texture, bool opaque)
+{
+    texture->opaque = opaque;
+}
+
+bool texture_data_opaque(const unsigned char *data, unsigned int num_pixels, int channels)
+{
+    if (channels == 3)
+        return true;
+    if (channels != 4)
+        return false;
+
+    unsigned int i;
+    for (i = 0; i < num_pixels; i++)
+        if (data[i * 4 + 3] != 0xFF)
+            return false;
+
+    return true;
+}
+
 void texture_use(Texture *texture, int slot)
 {
-    if (!texture || slot < 0 || slot > 15)
+    int max_units = graphics.max_texture_units ? graphics.max_texture_units : 16;
+
+    if (!texture || slot < 0 || slot >= max_units)
         return;
 
     glActiveTexture(GL_TEXTURE0 + slot);
+    glBindTexture(texture->target, texture->id);
+}
+
+bool texture_array_place(Texture *texture)
+{
+    if (texture->array)
+        return true;
+
+    if (texture->target != GL_TEXTURE_2D)
+        return false;
+
+    GLenum internal_format, format;
+    switch (texture->channels)
+    {
+        case 1:
+            internal_format = GL_R8;
+            format = GL_RED;
+            break;
+        case 3:
+            internal_format = GL_RGB8;
+            format = GL_RGB;
+            break;
+        case 4:
+            internal_format = GL_RGBA8;
+            format = GL_RGBA;
+            break;
+        default:
+            return false;
+    }
+
+    // Look for a free layer in an array of the same size and format
+    TexturePool *pool = NULL;
+    unsigned int i, layer = 0;
+    for (i = 0; i < graphics.num_texture_pools && !pool; i++)
+    {
+        TexturePool *candidate = &graphics.texture_pools[i];
+
+        if (candidate->array->width != texture->width || candidate->array->height != texture->height ||
+            candidate->array->channels != texture->channels)
+            continue;
+
+        for (layer = 0; layer < candidate->num_layers; layer++)
+        {
+            if (!candidate->used[layer])
+            {
+                pool = candidate;
+                break;
+            }
+        }
+    }
+
+    unsigned int layer_size = texture->width * texture->height * texture->channels;
+
+    if (!pool)
+    {
+        // Keep each array around 16 MB so big textures don't reserve huge arrays
+        unsigned int num_layers = (16 << 20) / layer_size;
+        if (num_layers < 1)
+            num_layers = 1;
+        if (num_layers > TEXTURE_ARRAY_MAX_LAYERS)
+            num_layers = TEXTURE_ARRAY_MAX_LAYERS;
+
+        graphics.texture_pools = realloc(graphics.texture_pools, (graphics.num_texture_pools + 1) * sizeof(TexturePool));
+        pool = &graphics.texture_pools[graphics.num_texture_pools++];
+        memset(pool, 0, sizeof(TexturePool));
+        pool->num_layers = num_layers;
+
+        pool->array = calloc(1, sizeof(Texture));
+        pool->array->width = texture->width;
+        pool->array->height = texture->height;
+        pool->array->channels = texture->channels;
+        pool->array->target = GL_TEXTURE_2D_ARRAY;
+
+        glGenTextures(1, &pool->array->id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, pool->array->id);
+
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internal_format, texture->width, texture->height, num_layers, 0, format, GL_UNSIGNED_BYTE, NULL);
+
+        layer = 0;
+    }
+
+    // One time copy of the texture into its layer. Pools only hold one size, so
+    // this overwrites every texel a released texture left in a reused layer
+    unsigned char *pixels = malloc(layer_size);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
     glBindTexture(GL_TEXTURE_2D, texture->id);
+    glGetTexImage(GL_TEXTURE_2D, 0, format, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, pool->array->id);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, texture->width, texture->height, 1, format, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    free(pixels);
+
+    pool->used[layer] = 1;
+    texture->array = pool->array;
+    texture->layer = layer;
+
+    return true;
+}
+
+void texture_array_release(Texture *texture)
+{
+    unsigned int i;
+    for (i = 0; i < graphics.num_texture_pools; i++)
+    {
+        if (graphics.texture_pools[i].array == texture->array)
+            graphics.texture_pools[i].used[texture->layer] = 0;
+    }
+
+    texture->array = NULL;
+    texture->layer = 0;
+}
+
+unsigned long long texture_get_handle(Texture *texture)
+{
+    if (!texture->handle && graphics.get_texture_handle)
+    {
+        texture->handle = graphics.get_texture_handle(texture->id);
+        graphics.make_texture_handle_resident(texture->handle);
+    }
+
+    return texture->handle;
 }
 
 /*********************************************************
@@ -447,271 +860,3267 @@ void texture_use(Texture *texture, int slot)
 
 Batch *batch_create(unsigned int max_elements)
 {
-    Batch *batch = malloc(sizeof(Batch));
+    return batch_create_with_options((BatchOptions){max_elements, 0, 0});
+}
+
+Batch *batch_create_with_options(BatchOptions options)
+{
+    Batch *batch = calloc(1, sizeof(Batch));
+    unsigned int max_elements = options.max_elements > BATCH_MIN_ELEMENTS ? options.max_elements : BATCH_MIN_ELEMENTS;
+    unsigned int frames_in_flight = options.frames_in_flight ? options.frames_in_flight : 3;
+
+    if (frames_in_flight > BATCH_MAX_FRAMES_IN_FLIGHT)
+        frames_in_flight = BATCH_MAX_FRAMES_IN_FLIGHT;
 
     batch->max_elements = max_elements;
-    batch->num_quads = 0;
-    batch->num_textures = 1;
-    batch->num_lines = 0;
+    batch->max_draw_elements = max_elements < BATCH_MAX_DRAW_ELEMENTS ? max_elements : BATCH_MAX_DRAW_ELEMENTS;
+    batch->quads.count = 0;
+    batch->lines.count = 0;
+    batch->shapes.count = 0;
+    batch->flags = options.flags;
+    batch->transform = transform2d_identity();
+    batch->clip = BATCH_NO_CLIP;
+    batch->opaque_start = BATCH_NO_PASS;
+    batch->opaque_end = BATCH_NO_PASS;
+
+    if (batch->flags & BATCH_DEPTH_PASSES)
+        batch->flags |= BATCH_DEFERRED;
+
+    // Bindless falls back to texture arrays when the extension is missing
+    if ((batch->flags & BATCH_BINDLESS) && !graphics.get_texture_handle)
+        batch->flags = (batch->flags & ~BATCH_BINDLESS) | BATCH_TEXTURE_ARRAYS;
+    if (batch->flags & BATCH_BINDLESS)
+        batch->flags &= ~BATCH_TEXTURE_ARRAYS;
+
+    if (batch->flags & BATCH_INSTANCED)
+        batch->quads.size = sizeof(QuadInstance);
+    else if (batch->flags & BATCH_COMPACT)
+        batch->quads.size = 4 * sizeof(CompactQuadVertex);
+    else
+        batch->quads.size = 4 * sizeof(QuadVertex);
+
+    // Lines are stored as quads, expanded on the CPU to their full width
+    batch->lines.size = 4 * (batch->flags & BATCH_COMPACT ? sizeof(CompactLineVertex) : sizeof(LineVertex));
 
-    batch->quad_vertices = malloc(max_elements * 4 * sizeof(QuadVertex));
-    batch->quad_indices = malloc(max_elements * 6 * sizeof(unsigned int));
-    batch->line_vertices = malloc(max_elements * 2 * sizeof(LineVertex));
+    // Shapes need their parameters in full, so they ignore BATCH_COMPACT
+    batch->shapes.size = 4 * sizeof(ShapeVertex);
+
+    batch->max_textures = batch->flags & BATCH_BINDLESS ? BATCH_MAX_BINDLESS_TEXTURES : BATCH_MAX_TEXTURES;
+    batch->texture_map_size = 2 * BATCH_MAX_TEXTURES;
+    batch->texture_map = calloc(batch->texture_map_size, sizeof(BatchTextureEntry));
+    batch->texture_capacity = 4 * BATCH_MAX_TEXTURES;
+    batch->textures = malloc(batch->texture_capacity * sizeof(Texture *));
 
-    batch->textures = malloc(16 * sizeof(Texture *));
     unsigned char white[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
-    batch->textures[0] = texture_load(white, 1, 1, 4);
+    batch->white = texture_load(white, 1, 1, 4);
+    batch->textures[0] = batch->white;
+
+    if ((batch->flags & BATCH_TEXTURE_ARRAYS) && texture_array_place(batch->white))
+    {
+        batch->textures[0] = batch->white->array;
+        batch->white_id = batch->white->layer;
+    }
 
-    // Generate indices
-    int i, index = 0;
-    for (i = 0; i < max_elements * 6; i += 6)
+    if (batch->flags & BATCH_BINDLESS)
     {
-        batch->quad_indices[i + 0] = index + 0;
-        batch->quad_indices[i + 1] = index + 1;
-        batch->quad_indices[i + 2] = index + 2;
+        batch->handles = malloc(batch->texture_capacity * sizeof(unsigned long long));
+        batch->handles[0] = texture_get_handle(batch->white);
 
-        batch->quad_indices[i + 3] = index + 2;
-        batch->quad_indices[i + 4] = index + 3;
-        batch->quad_indices[i + 5] = index + 0;
+        glGenBuffers(1, &batch->handle_buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, batch->handle_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, (long)(batch->texture_capacity * sizeof(unsigned long long)), NULL, GL_STREAM_DRAW);
 
-        index += 4;
+        glGenTextures(1, &batch->handle_texture);
+        glBindTexture(GL_TEXTURE_BUFFER, batch->handle_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, batch->handle_buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    batch_reset_textures(batch);
+
+    // Line quads always use the shared indices, instanced sprites never do
+    graphics_reserve_quad_indices(batch->max_draw_elements);
+
+    batch_stream_create(batch, &batch->quads, max_elements, frames_in_flight);
+
+    if (batch->flags & BATCH_INSTANCED)
+    {
+        batch_bind_instances(batch, 0);
     }
+    else
+    {
+        if (batch->flags & BATCH_COMPACT)
+        {
+            unsigned int stride = sizeof(CompactQuadVertex);
 
-    glGenVertexArrays(1, &batch->quad_vao);
-    glGenBuffers(1, &batch->quad_vbo);
-    glGenBuffers(1, &batch->quad_ebo);
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(CompactQuadVertex, position));
+            glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offsetof(CompactQuadVertex, color));
+            glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)offsetof(CompactQuadVertex, tex_coord));
+            glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, stride, (void *)offsetof(CompactQuadVertex, tex_id));
+            glVertexAttribPointer(4, 1, GL_SHORT, GL_TRUE, stride, (void *)offsetof(CompactQuadVertex, depth));
 
-    glBindVertexArray(batch->quad_vao);
+            int i;
+            for (i = 0; i < 5; i++)
+                glEnableVertexAttribArray(i);
+        }
+        else
+        {
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, position));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, color));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, tex_coord));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, tex_id));
+            glEnableVertexAttribArray(3);
+        }
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, graphics.quad_ebo);
+    }
+
+    glBindVertexArray(0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, batch->quad_vbo);
-    glBufferData(GL_ARRAY_BUFFER, (long)(batch->max_elements * 4 * sizeof(QuadVertex)), NULL, GL_DYNAMIC_DRAW);
+    batch_stream_create(batch, &batch->lines, max_elements, frames_in_flight);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, position));
+    if (batch->flags & BATCH_COMPACT)
+    {
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(CompactLineVertex), (void *)offsetof(CompactLineVertex, position));
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactLineVertex), (void *)offsetof(CompactLineVertex, color));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(CompactLineVertex), (void *)offsetof(CompactLineVertex, edge));
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void *)offsetof(LineVertex, position));
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void *)offsetof(LineVertex, color));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void *)offsetof(LineVertex, edge));
+    }
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, color));
     glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, tex_coord));
     glEnableVertexAttribArray(2);
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (void *)offsetof(QuadVertex, tex_id));
-    glEnableVertexAttribArray(3);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch->quad_ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (long)(batch->max_elements * 6 * sizeof(unsigned int)), batch->quad_indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, graphics.quad_ebo);
 
     glBindVertexArray(0);
 
-    glGenVertexArrays(1, &batch->line_vao);
-    glGenBuffers(1, &batch->line_vbo);
+    batch_stream_create(batch, &batch->shapes, max_elements, frames_in_flight);
 
-    glBindVertexArray(batch->line_vao);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (void *)offsetof(ShapeVertex, position));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (void *)offsetof(ShapeVertex, color));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (void *)offsetof(ShapeVertex, local));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (void *)offsetof(ShapeVertex, shape));
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), (void *)offsetof(ShapeVertex, arc));
 
-    glBindBuffer(GL_ARRAY_BUFFER, batch->line_vbo);
-    glBufferData(GL_ARRAY_BUFFER, (long)(batch->max_elements * 2 * sizeof(QuadVertex)), NULL, GL_DYNAMIC_DRAW);
+    int attribute;
+    for (attribute = 0; attribute < 5; attribute++)
+        glEnableVertexAttribArray(attribute);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void *)offsetof(LineVertex, position));
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void *)offsetof(LineVertex, color));
-    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, graphics.quad_ebo);
 
     glBindVertexArray(0);
 
+    if (batch->flags & BATCH_STREAMING)
+    {
+        batch->quads.data = stream_buffer_map(&batch->quads.stream, &batch->stats);
+        batch->lines.data = stream_buffer_map(&batch->lines.stream, &batch->stats);
+        batch->shapes.data = stream_buffer_map(&batch->shapes.stream, &batch->stats);
+    }
+
     return batch;
 }
 
 void batch_destroy(Batch *batch)
 {
-    glDeleteBuffers(1, &batch->quad_vbo);
-    glDeleteBuffers(1, &batch->quad_ebo);
-    glDeleteVertexArrays(1, &batch->quad_vao);
+    batch_stream_destroy(batch, &batch->quads);
+    batch_stream_destroy(batch, &batch->lines);
+    batch_stream_destroy(batch, &batch->shapes);
 
-    glDeleteBuffers(1, &batch->line_vbo);
-    glDeleteVertexArrays(1, &batch->line_vao);
+    if (batch->flags & BATCH_BINDLESS)
+    {
+        glDeleteTextures(1, &batch->handle_texture);
+        glDeleteBuffers(1, &batch->handle_buffer);
+        free(batch->handles);
+    }
 
-    texture_unload(batch->textures[0]);
+    texture_unload(batch->white);
 
+    free(batch->texture_map);
     free(batch->textures);
-    free(batch->line_vertices);
-    free(batch->quad_vertices);
-    free(batch->quad_indices);
+    free(batch->commands);
+    free(batch->sort_entries);
+    free(batch->sort_scratch);
+    free(batch->transform_stack);
+    free(batch->clip_stack);
+    free(batch->polygon_indices);
+    free(batch->text_glyphs);
+    free(batch->text_lines);
+    free(batch->line_quads);
+    free(batch->frozen_depths);
+
+    unsigned int i;
+    for (i = 0; i < batch->max_recorders; i++)
+    {
+        free(batch->recorders[i].quad_data);
+        free(batch->recorders[i].texture_indices);
+        free(batch->recorders[i].textures);
+    }
+    free(batch->recorders);
+
     free(batch);
 }
 
-void batch_add_sprite(Batch *batch, Vec2 position, Vec2 size, Texture *texture)
+void batch_stream_create(Batch *batch, BatchStream *stream, unsigned int max_elements, unsigned int frames_in_flight)
 {
-    if (batch->num_quads >= batch->max_elements)
-        return;
+    stream->capacity = max_elements;
+    stream->buffer_capacity = max_elements;
 
-    int i;
-    for (i = 1; i < batch->num_textures; i++)
+    // Streaming batches write straight into the mapped GL buffers instead
+    if (batch->flags & BATCH_STREAMING)
     {
-        if (batch->textures[i]->id == texture->id)
-            break;
+        stream_buffer_create(&stream->stream, max_elements * stream->size, frames_in_flight);
+        stream->vbo = stream->stream.buffer;
     }
-
-    if (i >= 15)
-        return;
-
-    if (i >= batch->num_textures)
+    else
     {
-        batch->textures[i] = texture;
-        batch->num_textures++;
-    }
-
-    unsigned int vertex_index = batch->num_quads * 4;
+        stream->data = malloc(max_elements * stream->size);
 
-    float left = position.x - (size.x / 2.0f);
-    float right = position.x + (size.x / 2.0f);
-    float top = position.y + (size.y / 2.0f);
-    float bottom = position.y - (size.y / 2.0f);
-
-    batch->quad_vertices[vertex_index + 0] = (QuadVertex){{left, top, 0}, {1, 1, 1, 1}, {0, 1}, (float)i};
-    batch->quad_vertices[vertex_index + 1] = (QuadVertex){{right, top, 0}, {1, 1, 1, 1}, {1, 1}, (float)i};
-    batch->quad_vertices[vertex_index + 2] = (QuadVertex){{right, bottom, 0}, {1, 1, 1, 1}, {1, 0}, (float)i};
-    batch->quad_vertices[vertex_index + 3] = (QuadVertex){{left, bottom, 0}, {1, 1, 1, 1}, {0, 0}, (float)i};
+        glGenBuffers(1, &stream->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+        glBufferData(GL_ARRAY_BUFFER, (long)(max_elements * stream->size), NULL, GL_DYNAMIC_DRAW);
+    }
 
-    batch->num_quads++;
+    // Left bound for the caller to describe its vertices
+    glGenVertexArrays(1, &stream->vao);
+    glBindVertexArray(stream->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
 }
 
-void batch_add_sprite_uv(Batch *batch, Vec2 position, Vec2 size, Vec2 uv[4], Texture *texture)
+void batch_stream_destroy(Batch *batch, BatchStream *stream)
 {
-    if (batch->num_quads >= batch->max_elements)
-        return;
-
-    int i;
-    for (i = 1; i < batch->num_textures; i++)
+    if (batch->flags & BATCH_STREAMING)
     {
-        if (batch->textures[i]->id == texture->id)
-            break;
+        stream_buffer_destroy(&stream->stream);
     }
-
-    if (i >= 15)
-        return;
-
-    if (i >= batch->num_textures)
+    else
     {
-        batch->textures[i] = texture;
-        batch->num_textures++;
+        glDeleteBuffers(1, &stream->vbo);
+        free(stream->data);
     }
 
-    unsigned int vertex_index = batch->num_quads * 4;
+    glDeleteVertexArrays(1, &stream->vao);
+    free(stream->draws);
+}
 
-    float left = position.x - (size.x / 2.0f);
-    float right = position.x + (size.x / 2.0f);
-    float top = position.y + (size.y / 2.0f);
-    float bottom = position.y - (size.y / 2.0f);
+void batch_add_sprite(Batch *batch, Vec2 position, Vec2 size, Texture *texture)
+{
+    static const Vec2 uv[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
 
-    batch->quad_vertices[vertex_index + 0] = (QuadVertex){{left, top, 0}, {1, 1, 1, 1}, uv[0], (float)i};
-    batch->quad_vertices[vertex_index + 1] = (QuadVertex){{right, top, 0}, {1, 1, 1, 1}, uv[1], (float)i};
-    batch->quad_vertices[vertex_index + 2] = (QuadVertex){{right, bottom, 0}, {1, 1, 1, 1}, uv[2], (float)i};
-    batch->quad_vertices[vertex_index + 3] = (QuadVertex){{left, bottom, 0}, {1, 1, 1, 1}, uv[3], (float)i};
+    batch_add_sprite_uv(batch, position, size, (Vec2 *)uv, texture);
+}
 
-    batch->num_quads++;
+void batch_add_sprite_uv(Batch *batch, Vec2 position, Vec2 size, Vec2 uv[4], Texture *texture)
+{
+    if ((batch->flags & BATCH_DEFERRED) || batch->transformed)
+        batch_add_transformed(batch, (Transform2D){size.x, 0, position.x, 0, size.y, position.y}, uv, (Vec4){1, 1, 1, 1}, texture);
+    else
+        batch_emit_quad(batch, position, size, uv, (Vec4){1, 1, 1, 1}, texture);
 }
 
 void batch_add_text(Batch *batch, Vec2 position, Font *font, const char *text)
 {
-    float x = position.x, y = position.y;
-    int i = 0;
-    while(text[i])
-    {
-        if (text[i] < 32)
-        {
-            i++;
-            continue;
-        }
-
-        stbtt_aligned_quad q;
-        stbtt_GetBakedQuad((stbtt_bakedchar *)font->character_data, font->bitmap->width, font->bitmap->height, text[i] - 32, &x, &y, &q, 1);
+    batch_add_text_scaled(batch, position, font, text, font->size, (Vec4){1, 1, 1, 1});
+}
 
-        Character c = font->character_data[text[i] - 32];
+void batch_add_text_scaled(Batch *batch, Vec2 position, Font *font, const char *text, float size, Vec4 color)
+{
+    batch_add_text_span(batch, position, font, text, NULL, size, color);
+}
 
-        Vec2 uv[4];
-        uv[0] = (Vec2){q.s0, q.t0};
-        uv[1] = (Vec2){q.s1, q.t0};
-        uv[2] = (Vec2){q.s1, q.t1};
-        uv[3] = (Vec2){q.s0, q.t1};
+void batch_add_quad(Batch *batch, Vec2 position, Vec2 size, Vec4 color)
+{
+    static const Vec2 uv[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
 
-        float left = x - c.xadvance + q.x0;
-        float top = y + q.y0;
-        float right = x - c.xadvance + q.x1;
-        float bottom = y + q.y1;
+    if ((batch->flags & BATCH_DEFERRED) || batch->transformed)
+        batch_add_transformed(batch, (Transform2D){size.x, 0, position.x, 0, size.y, position.y}, uv, color, NULL);
+    else
+        batch_emit_quad(batch, position, size, uv, color, NULL);
+}
 
-        float width = right - left;
-        float height = bottom - top;
+void batch_add_sprite_rotated(Batch *batch, Vec2 position, Vec2 size, float rotation, Vec2 pivot, Texture *texture)
+{
+    static const Vec2 uv[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
 
-        batch_add_sprite_uv(batch, (Vec2){x - (c.xadvance / 2.0f), y - (q.y1 / 2.0f) - (top / 2.0f)}, (Vec2){width, height}, uv, font->bitmap);
-        i++;
-    }
+    batch_add_transformed(batch, batch_rotated_transform(position, size, rotation, pivot), uv, (Vec4){1, 1, 1, 1}, texture);
 }
 
-void batch_add_quad(Batch *batch, Vec2 position, Vec2 size, Vec4 color)
+void batch_add_quad_rotated(Batch *batch, Vec2 position, Vec2 size, float rotation, Vec2 pivot, Vec4 color)
 {
-    if (batch->num_quads >= batch->max_elements)
-        return;
+    static const Vec2 uv[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
 
-    unsigned int vertex_index = batch->num_quads * 4;
+    batch_add_transformed(batch, batch_rotated_transform(position, size, rotation, pivot), uv, color, NULL);
+}
 
-    float left = position.x - (size.x / 2.0f);
-    float right = position.x + (size.x / 2.0f);
-    float top = position.y + (size.y / 2.0f);
-    float bottom = position.y - (size.y / 2.0f);
+void batch_add_sprite_transformed(Batch *batch, Transform2D transform, Vec2 uv[4], Vec4 color, Texture *texture)
+{
+    batch_add_transformed(batch, transform, uv, color, texture);
+}
 
-    batch->quad_vertices[vertex_index + 0] = (QuadVertex){{left, top, 0}, color, {0, 1}, 0};
-    batch->quad_vertices[vertex_index + 1] = (QuadVertex){{right, top, 0}, color, {1, 1}, 0};
-    batch->quad_vertices[vertex_index + 2] = (QuadVertex){{right, bottom, 0}, color, {1, 0}, 0};
-    batch->quad_vertices[vertex_index + 3] = (QuadVertex){{left, bottom, 0}, color, {0, 0}, 0};
+void batch_push_transform(Batch *batch, Transform2D transform)
+{
+    if (batch->num_transforms == batch->max_transforms)
+    {
+        batch->max_transforms = batch->max_transforms ? batch->max_transforms * 2 : 8;
+        batch->transform_stack = realloc(batch->transform_stack, batch->max_transforms * sizeof(Transform2D));
+    }
 
-    batch->num_quads++;
+    batch->transform_stack[batch->num_transforms++] = batch->transform;
+    batch->transform = transform2d_mul(batch->transform, transform);
+    batch->transformed = !transform2d_is_identity(batch->transform);
 }
 
-void batch_add_line(Batch *batch, Vec2 start, Vec2 end, Vec4 color, float width)
+void batch_pop_transform(Batch *batch)
 {
-    if (batch->num_lines >= batch->max_elements)
+    if (!batch->num_transforms)
         return;
 
-    glLineWidth(width);
+    batch->transform = batch->transform_stack[--batch->num_transforms];
+    batch->transformed = !transform2d_is_identity(batch->transform);
+}
+
+void batch_push_clip(Batch *batch, Vec2 position, Vec2 size)
+{
+    if (batch->num_clips == batch->max_clips)
+    {
+        batch->max_clips = batch->max_clips ? batch->max_clips * 2 : 8;
+        batch->clip_stack = realloc(batch->clip_stack, batch->max_clips * sizeof(Vec4));
+    }
 
-    unsigned int vertex_index = batch->num_lines * 2;
+    batch->clip_stack[batch->num_clips++] = batch->clip;
 
-    batch->line_vertices[vertex_index + 0] = (LineVertex){{start.x, start.y, 0}, color};
-    batch->line_vertices[vertex_index + 1] = (LineVertex){{end.x, end.y, 0}, color};
+    // Nested clips can only shrink
+    Vec4 clip = batch->clip;
+    if (position.x > clip.x)
+        clip.x = position.x;
+    if (position.y > clip.y)
+        clip.y = position.y;
+    if (position.x + size.x < clip.z)
+        clip.z = position.x + size.x;
+    if (position.y + size.y < clip.w)
+        clip.w = position.y + size.y;
 
-    batch->num_lines++;
+    batch_set_clip(batch, clip);
 }
 
-/*********************************************************
+void batch_pop_clip(Batch *batch)
+{
+    if (!batch->num_clips)
+        return;
+
+    batch_set_clip(batch, batch->clip_stack[--batch->num_clips]);
+}
+
+void batch_add_sprites_soa(Batch *batch, unsigned int count, const Vec2 *positions, const Vec2 *sizes, const Vec4 *colors, const Vec4 *uv_rects, Texture **textures)
+{
+    static const Vec4 white = {1, 1, 1, 1};
+    static const Vec4 full = {0, 0, 1, 1};
+
+    // Colors that get premultiplied can't be streamed straight out either
+    bool converts = ((batch->flags & BATCH_PREMULTIPLIED_ALPHA) && (batch->blend == BLEND_ALPHA || batch->blend == BLEND_ADDITIVE)) ||
+                    batch->blend == BLEND_MULTIPLY;
+
+    if ((batch->flags & BATCH_DEFERRED) || batch->transformed || batch->num_clips || converts)
+    {
+        Vec2 uv[4];
+
+        unsigned int i;
+        for (i = 0; i < count; i++)
+        {
+            Transform2D transform = {sizes[i].x, 0, positions[i].x, 0, sizes[i].y, positions[i].y};
+
+            batch_rect_uv(uv_rects ? uv_rects[i] : full, uv);
+            batch_add_transformed(batch, transform, uv, colors ? colors[i] : white, textures ? textures[i] : NULL);
+        }
+        return;
+    }
+
+    unsigned int tex_ids[BATCH_SOA_CHUNK];
+
+    unsigned int first, size;
+    for (first = 0; first < count; first += size)
+    {
+        unsigned int room = batch_draw_room(batch);
+
+        size = count - first < BATCH_SOA_CHUNK ? count - first : BATCH_SOA_CHUNK;
+        if (size > room)
+            size = room;
+
+        if (!batch_reserve(batch, &batch->quads, size))
+            continue;
+
+        // Sprites are written in runs that share a texture set. A run ends
+        // before a lookup that could split the draw or a sprite that can't
+        // get a slot at all
+        unsigned int i, run = first;
+        for (i = first; i < first + size; i++)
+        {
+            Texture *texture = textures ? textures[i] : NULL;
+
+            if (!texture)
+            {
+                tex_ids[i - first] = batch->white_id;
+                continue;
+            }
+
+            if (texture != batch->last_texture && batch->num_textures >= batch->max_textures)
+            {
+                batch_write_sprites(batch, i - run, positions + run, sizes + run, colors ? colors + run : NULL,
+                                    uv_rects ? uv_rects + run : NULL, tex_ids + (run - first));
+                run = i;
+            }
+
+            int slot = batch_texture_slot(batch, texture);
+
+            if (slot < 0)
+            {
+                batch_write_sprites(batch, i - run, positions + run, sizes + run, colors ? colors + run : NULL,
+                                    uv_rects ? uv_rects + run : NULL, tex_ids + (run - first));
+                run = i + 1;
+                continue;
+            }
+
+            tex_ids[i - first] = (unsigned int)slot;
+        }
+
+        batch_write_sprites(batch, i - run, positions + run, sizes + run, colors ? colors + run : NULL,
+                            uv_rects ? uv_rects + run : NULL, tex_ids + (run - first));
+    }
+}
+
+void batch_add_triangles(Batch *batch, const BatchVertex *vertices, unsigned int num_vertices, const unsigned int *indices, unsigned int num_indices, Texture *texture)
+{
+    // Instances only describe rectangles
+    if (batch->flags & BATCH_INSTANCED)
+        return;
+
+    unsigned int i = 0;
+    while (i + 3 <= num_indices)
+    {
+        unsigned int first[3], second[3], quad[4];
+        unsigned int k;
+
+        for (k = 0; k < 3; k++)
+            first[k] = indices ? indices[i + k] : i + k;
+
+        if (first[0] >= num_vertices || first[1] >= num_vertices || first[2] >= num_vertices)
+        {
+            i += 3;
+            continue;
+        }
+
+        // Two triangles fill a quad when the second starts where the first ends
+        bool paired = false;
+        if (i + 6 <= num_indices)
+        {
+            for (k = 0; k < 3; k++)
+                second[k] = indices ? indices[i + 3 + k] : i + 3 + k;
+
+            paired = second[0] < num_vertices && second[1] < num_vertices && second[2] < num_vertices &&
+                     batch_pair_triangles(first, second, quad);
+        }
+
+        // Otherwise the last corner repeats and the quad's second triangle is empty
+        if (!paired)
+        {
+            quad[0] = first[0];
+            quad[1] = first[1];
+            quad[2] = first[2];
+            quad[3] = first[2];
+        }
+
+        BatchVertex corners[4];
+        for (k = 0; k < 4; k++)
+            corners[k] = vertices[quad[k]];
+
+        batch_emit_vertices(batch, corners, texture);
+        i += paired ? 6 : 3;
+    }
+}
+
+void batch_add_convex_polygon(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color)
+{
+    if (count < 3 || (batch->flags & BATCH_INSTANCED))
+        return;
+
+    // A fan from the first point, two of its triangles per quad
+    BatchVertex corners[4];
+
+    unsigned int i, k;
+    for (i = 1; i + 1 < count; i += 2)
+    {
+        unsigned int fan[4] = {0, i, i + 1, i + 2 < count ? i + 2 : i + 1};
+
+        for (k = 0; k < 4; k++)
+            corners[k] = (BatchVertex){points[fan[k]], {0, 0}, color};
+
+        batch_emit_vertices(batch, corners, NULL);
+    }
+}
+
+void batch_add_polygon(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color)
+{
+    if (count < 3 || (batch->flags & BATCH_INSTANCED))
+        return;
+
+    // The points still to clip, the triangles cut off and the quads they pack into
+    unsigned int needed = count + 7 * (count - 2);
+    if (needed > batch->max_polygon_indices)
+    {
+        batch->max_polygon_indices = needed;
+        batch->polygon_indices = realloc(batch->polygon_indices, needed * sizeof(unsigned int));
+    }
+
+    unsigned int *remaining = batch->polygon_indices;
+    unsigned int *triangles = remaining + count;
+    unsigned int *quads = triangles + 3 * (count - 2);
+
+    unsigned int num_triangles = batch_triangulate(points, count, remaining, triangles);
+    unsigned int num_quads = batch_pack_triangles(triangles, num_triangles, quads);
+
+    BatchVertex corners[4];
+
+    unsigned int i, k;
+    for (i = 0; i < num_quads; i++)
+    {
+        for (k = 0; k < 4; k++)
+            corners[k] = (BatchVertex){points[quads[i * 4 + k]], {0, 0}, color};
+
+        batch_emit_vertices(batch, corners, NULL);
+    }
+}
+
+unsigned int batch_triangulate(const Vec2 *points, unsigned int count, unsigned int *remaining, unsigned int *triangles)
+{
+    unsigned int num_remaining = count, num_triangles = 0;
+
+    float area = 0;
+
+    unsigned int i;
+    for (i = 0; i < count; i++)
+    {
+        Vec2 a = points[i], b = points[(i + 1) % count];
+        area += a.x * b.y - b.x * a.y;
+        remaining[i] = i;
+    }
+
+    float winding = area < 0 ? -1.0f : 1.0f;
+
+    i = 0;
+    unsigned int misses = 0;
+    while (num_remaining > 3)
+    {
+        if (batch_polygon_ear(points, remaining, num_remaining, i, winding))
+        {
+            triangles[num_triangles++] = remaining[(i + num_remaining - 1) % num_remaining];
+            triangles[num_triangles++] = remaining[i];
+            triangles[num_triangles++] = remaining[(i + 1) % num_remaining];
+
+            memmove(remaining + i, remaining + i + 1, (num_remaining - i - 1) * sizeof(unsigned int));
+            num_remaining--;
+            misses = 0;
+
+            // Step back so the next ear shares an edge with this one and the two can pair up
+            i = (i + num_remaining - 1) % num_remaining;
+            continue;
+        }
+
+        // Self intersecting input runs out of ears, so fan whatever is left
+        if (++misses > num_remaining)
+            break;
+
+        i = (i + 1) % num_remaining;
+    }
+
+    for (i = 1; i + 1 < num_remaining; i++)
+    {
+        triangles[num_triangles++] = remaining[0];
+        triangles[num_triangles++] = remaining[i];
+        triangles[num_triangles++] = remaining[i + 1];
+    }
+
+    return num_triangles;
+}
+
+unsigned int batch_pack_triangles(const unsigned int *triangles, unsigned int count, unsigned int *quads)
+{
+    unsigned int i, num_quads = 0;
+
+    for (i = 0; i + 3 <= count; )
+    {
+        unsigned int *quad = quads + num_quads++ * 4;
+        bool paired = i + 6 <= count && batch_pair_triangles(triangles + i, triangles + i + 3, quad);
+
+        if (!paired)
+        {
+            quad[0] = triangles[i];
+            quad[1] = triangles[i + 1];
+            quad[2] = triangles[i + 2];
+            quad[3] = triangles[i + 2];
+        }
+
+        i += paired ? 6 : 3;
+    }
+
+    return num_quads;
+}
+
+void batch_add_line(Batch *batch, Vec2 start, Vec2 end, Vec4 color, float width)
+{
+    Vec2 points[2];
+    points[0] = start;
+    points[1] = end;
+
+    batch_add_polyline(batch, points, 2, color, width, false);
+}
+
+void batch_add_polyline(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color, float width, bool closed)
+{
+    if (batch->frozen)
+        return;
+
+    unsigned int num_quads = batch_expand_polyline(points, count, width, closed, batch->line_join, batch->line_cap, &batch->line_quads, &batch->max_line_quads, 0);
+
+    unsigned int i;
+    for (i = 0; i < num_quads; i++)
+        batch_push_line_quad(batch, &batch->line_quads[i], color);
+}
+
+void batch_set_line_style(Batch *batch, LineJoin join, LineCap cap)
+{
+    batch->line_join = join;
+    batch->line_cap = cap;
+}
+
+void batch_add_circle(Batch *batch, Vec2 center, float radius, Vec4 color)
+{
+    batch_push_shape(batch, center, (Vec2){radius, radius}, radius, 0, 0, 0, color);
+}
+
+void batch_add_rounded_rect(Batch *batch, Vec2 position, Vec2 size, float radius, Vec4 color)
+{
+    Vec2 half_size = {size.x * 0.5f, size.y * 0.5f};
+    float limit = half_size.x < half_size.y ? half_size.x : half_size.y;
+
+    batch_push_shape(batch, position, half_size, radius < limit ? radius : limit, 0, 0, 0, color);
+}
+
+void batch_add_ring(Batch *batch, Vec2 center, float radius, float thickness, Vec4 color)
+{
+    batch_push_shape(batch, center, (Vec2){radius, radius}, radius, thickness, 0, (float)M_PI, color);
+}
+
+void batch_add_arc(Batch *batch, Vec2 center, float radius, float thickness, float start_angle, float end_angle, Vec4 color)
+{
+    float half_sweep = (end_angle - start_angle) * 0.5f;
+
+    if (half_sweep < 0)
+        half_sweep = -half_sweep;
+    if (half_sweep > (float)M_PI)
+        half_sweep = (float)M_PI;
+
+    // No thickness fills the arc in like a pie slice
+    if (thickness <= 0)
+        thickness = radius;
+
+    batch_push_shape(batch, center, (Vec2){radius, radius}, radius, thickness, (start_angle + end_angle) * 0.5f, half_sweep, color);
+}
+
+int batch_texture_slot(Batch *batch, Texture *texture)
+{
+    if (texture == batch->last_texture)
+        return (int)batch->last_slot;
+
+    Texture *binding = texture;
+
+    if (batch->flags & BATCH_TEXTURE_ARRAYS)
+    {
+        if (!texture_array_place(texture))
+            return -1;
+
+        binding = texture->array;
+    }
+
+    int slot = batch_texture_find(batch, binding->id);
+
+    if (slot < 0)
+    {
+        // Out of slots: finish the current draw and start a fresh texture set
+        if (batch->num_textures >= batch->max_textures)
+        {
+            batch_close_draw(batch, &batch->quads);
+
+            batch->texture_base += batch->num_textures;
+            batch_reset_textures(batch);
+        }
+
+        if (batch->num_textures >= batch->texture_map_size / 2)
+            batch_grow_textures(batch);
+
+        slot = (int)batch->num_textures++;
+        batch->textures[batch->texture_base + slot] = binding;
+        batch_texture_insert(batch, binding->id, slot);
+
+        if (batch->flags & BATCH_BINDLESS)
+            batch->handles[batch->texture_base + slot] = texture_get_handle(texture);
+    }
+
+    if (batch->flags & BATCH_TEXTURE_ARRAYS)
+        slot = (slot << 8) | (int)texture->layer;
+
+    batch->last_texture = texture;
+    batch->last_slot = slot;
+
+    return slot;
+}
+
+int batch_texture_find(Batch *batch, unsigned int key)
+{
+    unsigned int mask = batch->texture_map_size - 1;
+    unsigned int index = (key * 2654435769u) >> 16 & mask;
+
+    // Entries from an earlier generation count as empty, so a flush is O(1)
+    while (batch->texture_map[index].generation == batch->texture_generation)
+    {
+        if (batch->texture_map[index].key == key)
+            return (int)batch->texture_map[index].slot;
+
+        index = (index + 1) & mask;
+    }
+
+    return -1;
+}
+
+void batch_texture_insert(Batch *batch, unsigned int key, unsigned int slot)
+{
+    unsigned int mask = batch->texture_map_size - 1;
+    unsigned int index = (key * 2654435769u) >> 16 & mask;
+
+    while (batch->texture_map[index].generation == batch->texture_generation)
+        index = (index + 1) & mask;
+
+    batch->texture_map[index] = (BatchTextureEntry){key, slot, batch->texture_generation};
+}
+
+void batch_grow_textures(Batch *batch)
+{
+    free(batch->texture_map);
+
+    batch->texture_map_size *= 2;
+    batch->texture_map = calloc(batch->texture_map_size, sizeof(BatchTextureEntry));
+
+    unsigned int i;
+    for (i = 0; i < batch->num_textures; i++)
+        batch_texture_insert(batch, batch->textures[batch->texture_base + i]->id, i);
+}
+
+void batch_reset_textures(Batch *batch)
+{
+    // Each texture set starts with the white texture in slot 0
+    if (batch->texture_base + batch->max_textures > batch->texture_capacity)
+    {
+        while (batch->texture_base + batch->max_textures > batch->texture_capacity)
+            batch->texture_capacity *= 2;
+
+        batch->textures = realloc(batch->textures, batch->texture_capacity * sizeof(Texture *));
+
+        if (batch->flags & BATCH_BINDLESS)
+            batch->handles = realloc(batch->handles, batch->texture_capacity * sizeof(unsigned long long));
+    }
+
+    batch->textures[batch->texture_base] = batch->textures[0];
+
+    if (batch->flags & BATCH_BINDLESS)
+        batch->handles[batch->texture_base] = batch->handles[0];
+
+    batch->num_textures = 1;
+    batch->texture_generation++;
+    batch->last_texture = NULL;
+
+    batch_texture_insert(batch, batch->textures[0]->id, 0);
+}
+
+void batch_bind_textures(Batch *batch, unsigned int first, unsigned int end)
+{
+    if (end - first > batch->max_textures)
+        end = first + batch->max_textures;
+
+    if (batch->flags & BATCH_BINDLESS)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, batch->handle_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, (long)((end - first) * sizeof(unsigned long long)), batch->handles + first, GL_STREAM_DRAW);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, batch->handle_texture);
+        return;
+    }
+
+    unsigned int i;
+    for (i = first; i < end; i++)
+        texture_use(batch->textures[i], (int)(i - first));
+}
+
+bool batch_reserve(Batch *batch, BatchStream *stream, unsigned int count)
+{
+    if (batch->frozen)
+        return false;
+
+    // Every draw has to fit in the index buffer
+    if (stream->count - stream->draw_start + count > batch->max_draw_elements)
+        batch_close_draw(batch, stream);
+
+    if (stream->count + count <= stream->capacity)
+        return true;
+
+    if (batch->flags & BATCH_STREAMING)
+    {
+        batch_close_draw(batch, stream);
+
+        void *data = stream_buffer_next(&stream->stream, stream->count * stream->size, &batch->stats);
+
+        if (!data)
+        {
+            batch->stats.dropped += count;
+            return false;
+        }
+
+        stream->data = data;
+        stream->offset = stream->stream.region * stream->stream.region_size;
+        stream->count = 0;
+        stream->draw_start = 0;
+        return true;
+    }
+
+    while (stream->count + count > stream->capacity)
+        stream->capacity *= 2;
+
+    stream->data = realloc(stream->data, stream->capacity * stream->size);
+    return true;
+}
+
+void batch_set_clip(Batch *batch, Vec4 clip)
+{
+    if (!memcmp(&clip, &batch->clip, sizeof(Vec4)))
+        return;
+
+    // Everything added so far keeps the clip it was added with
+    batch_close_draw(batch, &batch->quads);
+    batch_close_draw(batch, &batch->lines);
+    batch_close_draw(batch, &batch->shapes);
+
+    batch->clip = clip;
+}
+
+bool batch_clip_rejects(Batch *batch, const Vec2 *points, unsigned int count)
+{
+    if (!batch->num_clips)
+        return false;
+
+    Vec2 min = points[0], max = points[0];
+
+    unsigned int i;
+    for (i = 1; i < count; i++)
+    {
+        min.x = points[i].x < min.x ? points[i].x : min.x;
+        min.y = points[i].y < min.y ? points[i].y : min.y;
+        max.x = points[i].x > max.x ? points[i].x : max.x;
+        max.y = points[i].y > max.y ? points[i].y : max.y;
+    }
+
+    // Partly visible primitives are left for the scissor test
+    if (max.x > batch->clip.x && min.x < batch->clip.z && max.y > batch->clip.y && min.y < batch->clip.w)
+        return false;
+
+    batch->stats.clipped++;
+    return true;
+}
+
+bool batch_clip_rejects_transform(Batch *batch, const Transform2D *transform)
+{
+    if (!batch->num_clips)
+        return false;
+
+    // Half extents of the unit square mapped through the transform
+    float x = (fabsf(transform->m00) + fabsf(transform->m01)) * 0.5f;
+    float y = (fabsf(transform->m10) + fabsf(transform->m11)) * 0.5f;
+    Vec2 bounds[2] = {{transform->m02 - x, transform->m12 - y}, {transform->m02 + x, transform->m12 + y}};
+
+    return batch_clip_rejects(batch, bounds, 2);
+}
+
+BlendMode batch_quad_blend(Batch *batch)
+{
+    if ((batch->flags & BATCH_PREMULTIPLIED_ALPHA) && batch->blend != BLEND_MULTIPLY)
+        return BLEND_PREMULTIPLIED;
+
+    return batch->blend;
+}
+
+Vec4 batch_blend_color(Batch *batch, Vec4 color)
+{
+    // Multiply blends premultiplied whether or not the batch does
+    if (batch->blend == BLEND_MULTIPLY)
+        return (Vec4){color.x * color.w, color.y * color.w, color.z * color.w, color.w};
+
+    if (!(batch->flags & BATCH_PREMULTIPLIED_ALPHA))
+        return color;
+
+    // Additive is premultiplied with no alpha, so it covers nothing it adds to
+    switch (batch->blend)
+    {
+        case BLEND_ALPHA:
+            return (Vec4){color.x * color.w, color.y * color.w, color.z * color.w, color.w};
+        case BLEND_ADDITIVE:
+            return (Vec4){color.x * color.w, color.y * color.w, color.z * color.w, 0};
+        default:
+            return color;
+    }
+}
+
+unsigned int batch_draw_room(Batch *batch)
+{
+    // A full draw gets closed by the next reserve, so the room is a whole new one
+    unsigned int used = batch->quads.count - batch->quads.draw_start;
+
+    return used < batch->max_draw_elements ? batch->max_draw_elements - used : batch->max_draw_elements;
+}
+
+void batch_close_draw(Batch *batch, BatchStream *stream)
+{
+    if (stream->count == stream->draw_start)
+        return;
+
+    if (stream->num_draws == stream->max_draws)
+    {
+        stream->max_draws = stream->max_draws ? stream->max_draws * 2 : 8;
+        stream->draws = realloc(stream->draws, stream->max_draws * sizeof(BatchDraw));
+    }
+
+    // Only quads are textured or blend by their sort key
+    BatchDraw *draw = &stream->draws[stream->num_draws++];
+    draw->offset = stream->offset + stream->draw_start * stream->size;
+    draw->count = stream->count - stream->draw_start;
+    draw->texture_base = stream == &batch->quads ? batch->texture_base : 0;
+    draw->clip = batch->clip;
+    draw->blend = stream == &batch->quads ? batch_quad_blend(batch) : batch->blend;
+
+    stream->draw_start = stream->count;
+}
+
+void batch_upload(Batch *batch, BatchStream *stream)
+{
+    unsigned int size = stream->count * stream->size;
+
+    if (batch->flags & BATCH_STREAMING)
+    {
+        stream_buffer_unmap(&stream->stream, size);
+    }
+    else if (!batch->frozen)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+
+        // The CPU side outgrew the GL buffer, so reallocate it to match
+        if (stream->capacity > stream->buffer_capacity)
+        {
+            stream->buffer_capacity = stream->capacity;
+            glBufferData(GL_ARRAY_BUFFER, (long)(stream->buffer_capacity * stream->size), NULL, GL_DYNAMIC_DRAW);
+        }
+
+        glBufferSubData(GL_ARRAY_BUFFER, 0, (long)size, stream->data);
+    }
+}
+
+void batch_rewind(Batch *batch, BatchStream *stream)
+{
+    if (batch->flags & BATCH_STREAMING)
+    {
+        stream_buffer_fence(&stream->stream);
+        stream->data = stream_buffer_map(&stream->stream, &batch->stats);
+        stream->offset = stream->stream.region * stream->stream.region_size;
+    }
+
+    stream->count = 0;
+    stream->num_draws = 0;
+    stream->draw_start = 0;
+}
+
+void batch_emit_quad(Batch *batch, Vec2 position, Vec2 size, const Vec2 uv[4], Vec4 color, Texture *texture)
+{
+    Transform2D bounds = {size.x, 0, position.x, 0, size.y, position.y};
+
+    if (batch_clip_rejects_transform(batch, &bounds))
+        return;
+
+    if (!batch_reserve(batch, &batch->quads, 1))
+        return;
+
+    color = batch_blend_color(batch, color);
+
+    if (!texture)
+    {
+        batch_push_quad(batch, position, size, uv, color, batch->white_id);
+        return;
+    }
+
+    int slot = batch_texture_slot(batch, texture);
+
+    if (slot < 0)
+        return;
+
+    batch_push_quad(batch, position, size, uv, color, slot);
+}
+
+void batch_emit_transformed(Batch *batch, const Transform2D *transform, const Vec2 uv[4], Vec4 color, Texture *texture)
+{
+    if (batch_clip_rejects_transform(batch, transform))
+        return;
+
+    if (!batch_reserve(batch, &batch->quads, 1))
+        return;
+
+    color = batch_blend_color(batch, color);
+
+    if (!texture)
+    {
+        batch_push_quad_transformed(batch, transform, uv, color, batch->white_id);
+        return;
+    }
+
+    int slot = batch_texture_slot(batch, texture);
+
+    if (slot < 0)
+        return;
+
+    batch_push_quad_transformed(batch, transform, uv, color, slot);
+}
+
+void batch_add_transformed(Batch *batch, Transform2D transform, const Vec2 uv[4], Vec4 color, Texture *texture)
+{
+    if (batch->transformed)
+        transform = transform2d_mul(batch->transform, transform);
+
+    if (batch->flags & BATCH_DEFERRED)
+        batch_record_quad(batch, &transform, uv, color, texture);
+    else
+        batch_emit_transformed(batch, &transform, uv, color, texture);
+}
+
+Transform2D batch_rotated_transform(Vec2 position, Vec2 size, float rotation, Vec2 pivot)
+{
+    float c = cosf(rotation);
+    float s = sinf(rotation);
+
+    // Turn around the pivot, then scale the unit square up to size
+    Transform2D result;
+
+    result.m00 = c * size.x;
+    result.m01 = -s * size.y;
+    result.m02 = position.x + pivot.x - (c * pivot.x - s * pivot.y);
+
+    result.m10 = s * size.x;
+    result.m11 = c * size.y;
+    result.m12 = position.y + pivot.y - (s * pivot.x + c * pivot.y);
+
+    return result;
+}
+
+void batch_record_quad(Batch *batch, const Transform2D *transform, const Vec2 uv[4], Vec4 color, Texture *texture)
+{
+    if (batch->frozen || batch_clip_rejects_transform(batch, transform))
+        return;
+
+    if (batch->num_commands == batch->max_commands)
+    {
+        if (batch->max_commands)
+            batch->max_commands *= 2;
+        else
+            batch->max_commands = batch->max_elements > BATCH_MIN_ELEMENTS ? batch->max_elements : BATCH_MIN_ELEMENTS;
+        batch->commands = realloc(batch->commands, batch->max_commands * sizeof(BatchCommand));
+        batch->sort_entries = realloc(batch->sort_entries, batch->max_commands * sizeof(BatchSortEntry));
+        batch->sort_scratch = realloc(batch->sort_scratch, batch->max_commands * sizeof(BatchSortEntry));
+    }
+
+    BatchCommand *command = &batch->commands[batch->num_commands];
+    command->transform = *transform;
+    memcpy(command->uv, uv, sizeof(command->uv));
+    command->color = color;
+    command->depth = batch->depth;
+    command->clip = batch->clip;
+    command->blend = batch->blend;
+    command->texture = texture;
+
+    if (batch->flags & BATCH_DEPTH_PASSES)
+        batch->sort_entries[batch->num_commands].key = batch_pass_sort_key(batch, texture, batch->depth, color);
+    else
+        batch->sort_entries[batch->num_commands].key = batch_sort_key(batch, texture, batch->depth);
+    batch->sort_entries[batch->num_commands].index = batch->num_commands;
+    batch->num_commands++;
+}
+
+unsigned long long batch_sort_key(Batch *batch, Texture *texture, float depth)
+{
+    if (!texture)
+        texture = batch->white;
+
+    // Sprites sharing an array share its bindings, so group them by the array
+    if ((batch->flags & BATCH_TEXTURE_ARRAYS) && texture_array_place(texture))
+        texture = texture->array;
+
+    // Map the float onto an unsigned int that sorts the same way (far to near)
+    unsigned int bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    bits = bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+
+    return (unsigned long long)batch->layer << BATCH_KEY_LAYER_SHIFT |
+           (unsigned long long)batch_quad_blend(batch) << BATCH_KEY_BLEND_SHIFT |
+           (unsigned long long)(texture->id & BATCH_KEY_TEXTURE_MASK) << BATCH_KEY_TEXTURE_SHIFT |
+           bits;
+}
+
+unsigned long long batch_pass_sort_key(Batch *batch, Texture *texture, float depth, Vec4 color)
+{
+    if (!texture)
+        texture = batch->white;
+
+    bool opaque = texture->opaque && color.w >= 1.0f && (batch->blend == BLEND_ALPHA || batch->blend == BLEND_PREMULTIPLIED);
+
+    if ((batch->flags & BATCH_TEXTURE_ARRAYS) && texture_array_place(texture))
+        texture = texture->array;
+
+    unsigned int bits;
+    memcpy(&bits, &depth, sizeof(bits));
+    bits = bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+
+    // Opaque sprites go near to far so the depth test rejects what they cover
+    if (opaque)
+        bits = ~bits;
+
+    return (unsigned long long)!opaque << BATCH_PASS_KEY_TRANSLUCENT_SHIFT |
+           (unsigned long long)bits << BATCH_PASS_KEY_DEPTH_SHIFT |
+           (unsigned long long)batch->layer << BATCH_PASS_KEY_LAYER_SHIFT |
+           (unsigned long long)batch_quad_blend(batch) << BATCH_PASS_KEY_BLEND_SHIFT |
+           (texture->id & BATCH_KEY_TEXTURE_MASK);
+}
+
+void batch_sort_commands(Batch *batch)
+{
+    BatchSortEntry *entries = batch->sort_entries;
+    BatchSortEntry *scratch = batch->sort_scratch;
+    unsigned int n = batch->num_commands;
+
+    // Least significant digit first, one byte per pass. Every pass is stable
+    // so equal keys stay in the order they were added
+    unsigned int shift;
+    for (shift = 0; shift < 64; shift += 8)
+    {
+        unsigned int counts[256] = { 0 };
+        unsigned int i;
+
+        for (i = 0; i < n; i++)
+            counts[(entries[i].key >> shift) & 0xFF]++;
+
+        // Nothing to reorder when every key has the same byte here
+        if (counts[(entries[0].key >> shift) & 0xFF] == n)
+            continue;
+
+        unsigned int total = 0;
+        for (i = 0; i < 256; i++)
+        {
+            unsigned int count = counts[i];
+            counts[i] = total;
+            total += count;
+        }
+
+        for (i = 0; i < n; i++)
+            scratch[counts[(entries[i].key >> shift) & 0xFF]++] = entries[i];
+
+        BatchSortEntry *temp = entries;
+        entries = scratch;
+        scratch = temp;
+    }
+
+    batch->sort_entries = entries;
+    batch->sort_scratch = scratch;
+}
+
+void batch_flush_commands(Batch *batch)
+{
+    if (!batch->num_commands)
+        return;
+
+    batch_sort_commands(batch);
+
+    float depth = batch->depth;
+    Vec4 clip = batch->clip;
+    BlendMode blend = batch->blend;
+
+    // Opaque sprites sort first and get draws of their own
+    bool opaque = (batch->flags & BATCH_DEPTH_PASSES) != 0;
+    if (opaque)
+    {
+        batch_close_draw(batch, &batch->quads);
+        batch->opaque_start = batch->quads.num_draws;
+    }
+
+    unsigned int i;
+    for (i = 0; i < batch->num_commands; i++)
+    {
+        BatchCommand *command = &batch->commands[batch->sort_entries[i].index];
+
+        if (opaque && batch->sort_entries[i].key >> BATCH_PASS_KEY_TRANSLUCENT_SHIFT)
+        {
+            batch_close_draw(batch, &batch->quads);
+            batch->opaque_end = batch->quads.num_draws;
+            opaque = false;
+        }
+
+        batch->depth = command->depth;
+        batch_set_clip(batch, command->clip);
+        batch_set_blend_mode(batch, command->blend);
+        batch_emit_transformed(batch, &command->transform, command->uv, command->color, command->texture);
+    }
+
+    if (opaque)
+    {
+        batch_close_draw(batch, &batch->quads);
+        batch->opaque_end = batch->quads.num_draws;
+    }
+
+    batch->depth = depth;
+    batch_set_clip(batch, clip);
+    batch_set_blend_mode(batch, blend);
+    batch->num_commands = 0;
+}
+
+void batch_push_quad(Batch *batch, Vec2 position, Vec2 size, const Vec2 uv[4], Vec4 color, unsigned int tex_id)
+{
+    void *out = (unsigned char *)batch->quads.data + batch->quads.count * batch->quads.size;
+
+    batch_write_quad(out, batch->flags, batch->depth, position, size, uv, color, tex_id);
+    batch->quads.count++;
+}
+
+void batch_write_quad(void *out, unsigned int flags, float depth, Vec2 position, Vec2 size, const Vec2 uv[4], Vec4 color, unsigned int tex_id)
+{
+    if (flags & BATCH_INSTANCED)
+    {
+        QuadInstance *instance = out;
+
+        instance->center = position;
+        instance->half_size = (Vec2){size.x / 2.0f, size.y / 2.0f};
+        instance->rotation = 0;
+
+        instance->color[0] = pack_unorm8(color.x);
+        instance->color[1] = pack_unorm8(color.y);
+        instance->color[2] = pack_unorm8(color.z);
+        instance->color[3] = pack_unorm8(color.w);
+
+        // The rect spans the bottom left (3) to the top right (1) corner
+        instance->tex_rect[0] = pack_unorm16(uv[3].x);
+        instance->tex_rect[1] = pack_unorm16(uv[3].y);
+        instance->tex_rect[2] = pack_unorm16(uv[1].x);
+        instance->tex_rect[3] = pack_unorm16(uv[1].y);
+
+        instance->tex_id = tex_id;
+    }
+    else if (flags & BATCH_COMPACT)
+    {
+        CompactQuadVertex *vertices = out;
+        unsigned char packed[4] = {pack_unorm8(color.x), pack_unorm8(color.y), pack_unorm8(color.z), pack_unorm8(color.w)};
+
+        float left = position.x - (size.x / 2.0f);
+        float right = position.x + (size.x / 2.0f);
+        float top = position.y + (size.y / 2.0f);
+        float bottom = position.y - (size.y / 2.0f);
+
+        vertices[0].position = (Vec2){left, top};
+        vertices[1].position = (Vec2){right, top};
+        vertices[2].position = (Vec2){right, bottom};
+        vertices[3].position = (Vec2){left, bottom};
+
+        int i;
+        for (i = 0; i < 4; i++)
+        {
+            memcpy(vertices[i].color, packed, 4);
+            vertices[i].tex_coord[0] = pack_unorm16(uv[i].x);
+            vertices[i].tex_coord[1] = pack_unorm16(uv[i].y);
+            vertices[i].tex_id = (unsigned short)tex_id;
+            vertices[i].depth = pack_snorm16(depth);
+        }
+    }
+    else
+    {
+        QuadVertex *vertices = out;
+
+        float left = position.x - (size.x / 2.0f);
+        float right = position.x + (size.x / 2.0f);
+        float top = position.y + (size.y / 2.0f);
+        float bottom = position.y - (size.y / 2.0f);
+
+        vertices[0] = (QuadVertex){{left, top, depth}, color, uv[0], (float)tex_id};
+        vertices[1] = (QuadVertex){{right, top, depth}, color, uv[1], (float)tex_id};
+        vertices[2] = (QuadVertex){{right, bottom, depth}, color, uv[2], (float)tex_id};
+        vertices[3] = (QuadVertex){{left, bottom, depth}, color, uv[3], (float)tex_id};
+    }
+}
+
+void batch_write_vertices(void *out, unsigned int flags, float depth, const Vec2 positions[4], const BatchVertex corners[4], unsigned int tex_id)
+{
+    int i;
+    if (flags & BATCH_COMPACT)
+    {
+        CompactQuadVertex *vertices = out;
+
+        for (i = 0; i < 4; i++)
+        {
+            vertices[i].position = positions[i];
+            vertices[i].color[0] = pack_unorm8(corners[i].color.x);
+            vertices[i].color[1] = pack_unorm8(corners[i].color.y);
+            vertices[i].color[2] = pack_unorm8(corners[i].color.z);
+            vertices[i].color[3] = pack_unorm8(corners[i].color.w);
+            vertices[i].tex_coord[0] = pack_unorm16(corners[i].tex_coord.x);
+            vertices[i].tex_coord[1] = pack_unorm16(corners[i].tex_coord.y);
+            vertices[i].tex_id = (unsigned short)tex_id;
+            vertices[i].depth = pack_snorm16(depth);
+        }
+    }
+    else
+    {
+        QuadVertex *vertices = out;
+
+        for (i = 0; i < 4; i++)
+            vertices[i] = (QuadVertex){{positions[i].x, positions[i].y, depth}, corners[i].color, corners[i].tex_coord, (float)tex_id};
+    }
+}
+
+void batch_emit_vertices(Batch *batch, const BatchVertex corners[4], Texture *texture)
+{
+    Vec2 positions[4];
+
+    int i;
+    for (i = 0; i < 4; i++)
+        positions[i] = batch->transformed ? transform2d_apply(batch->transform, corners[i].position) : corners[i].position;
+
+    if (batch_clip_rejects(batch, positions, 4) || !batch_reserve(batch, &batch->quads, 1))
+        return;
+
+    int slot = texture ? batch_texture_slot(batch, texture) : (int)batch->white_id;
+
+    if (slot < 0)
+        return;
+
+    BatchVertex blended[4];
+    for (i = 0; i < 4; i++)
+    {
+        blended[i] = corners[i];
+        blended[i].color = batch_blend_color(batch, corners[i].color);
+    }
+
+    void *out = (unsigned char *)batch->quads.data + batch->quads.count * batch->quads.size;
+
+    batch_write_vertices(out, batch->flags, batch->depth, positions, blended, (unsigned int)slot);
+    batch->quads.count++;
+}
+
+bool batch_pair_triangles(const unsigned int first[3], const unsigned int second[3], unsigned int quad[4])
+{
+    // The quad's triangles are (0, 1, 2) and (2, 3, 0), so look for a
+    // rotation of each where the second runs from the first's end back to its start
+    int i, j;
+    for (i = 0; i < 3; i++)
+    {
+        unsigned int a = first[i], b = first[(i + 1) % 3], c = first[(i + 2) % 3];
+
+        for (j = 0; j < 3; j++)
+        {
+            if (second[j] == c && second[(j + 2) % 3] == a)
+            {
+                quad[0] = a;
+                quad[1] = b;
+                quad[2] = c;
+                quad[3] = second[(j + 1) % 3];
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool batch_polygon_ear(const Vec2 *points, const unsigned int *remaining, unsigned int count, unsigned int ear, float winding)
+{
+    unsigned int prev = remaining[(ear + count - 1) % count];
+    unsigned int cur = remaining[ear];
+    unsigned int next = remaining[(ear + 1) % count];
+
+    Vec2 a = points[prev], b = points[cur], c = points[next];
+
+    // Reflex corners and flat ones aren't ears
+    if (vec2_cross(vec2_sub(b, a), vec2_sub(c, b)) * winding <= 0)
+        return false;
+
+    unsigned int i;
+    for (i = 0; i < count; i++)
+    {
+        unsigned int index = remaining[i];
+
+        if (index == prev || index == cur || index == next)
+            continue;
+
+        Vec2 p = points[index];
+        float d0 = vec2_cross(vec2_sub(b, a), vec2_sub(p, a)) * winding;
+        float d1 = vec2_cross(vec2_sub(c, b), vec2_sub(p, b)) * winding;
+        float d2 = vec2_cross(vec2_sub(a, c), vec2_sub(p, c)) * winding;
+
+        // Points on the edge count as inside so the cut never crosses the outline
+        if (d0 >= 0 && d1 >= 0 && d2 >= 0)
+            return false;
+    }
+
+    return true;
+}
+
+void batch_write_tex_id(void *out, unsigned int flags, unsigned int tex_id)
+{
+    int i;
+    if (flags & BATCH_INSTANCED)
+    {
+        ((QuadInstance *)out)->tex_id = tex_id;
+    }
+    else if (flags & BATCH_COMPACT)
+    {
+        for (i = 0; i < 4; i++)
+            ((CompactQuadVertex *)out)[i].tex_id = (unsigned short)tex_id;
+    }
+    else
+    {
+        for (i = 0; i < 4; i++)
+            ((QuadVertex *)out)[i].tex_id = (float)tex_id;
+    }
+}
+
+void batch_write_sprites(Batch *batch, unsigned int count, const Vec2 *positions, const Vec2 *sizes, const Vec4 *colors, const Vec4 *uv_rects, const unsigned int *tex_ids)
+{
+    static const Vec4 white = {1, 1, 1, 1};
+    static const Vec4 full = {0, 0, 1, 1};
+
+    unsigned int i = 0;
+
+#if defined(__SSE2__)
+    // The vertex math runs in SSE registers and each quad goes out as ten
+    // stores. Into a persistently mapped stream buffer they're non-temporal,
+    // as nothing on the CPU reads them again; client side copies are read
+    // right back by glBufferSubData, so those stay in the cache
+    if (!(batch->flags & (BATCH_INSTANCED | BATCH_COMPACT)))
+    {
+        float *out = (float *)((QuadVertex *)batch->quads.data + batch->quads.count * 4);
+        bool non_temporal = ((size_t)out & 15) == 0 && (batch->flags & BATCH_STREAMING) && batch->quads.stream.persistent;
+
+        const __m128 corner_sign = _mm_setr_ps(-0.5f, 0.5f, 0.5f, -0.5f);
+        const __m128 depth = _mm_set1_ps(batch->depth);
+
+        for (; i < count; i++, out += 40)
+        {
+            __m128 position = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)&positions[i]);
+            __m128 size = _mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)&sizes[i]);
+            __m128 color = _mm_loadu_ps((const float *)(colors ? &colors[i] : &white));
+            __m128 rect = _mm_loadu_ps((const float *)(uv_rects ? &uv_rects[i] : &full));
+            __m128 id = _mm_set1_ps((float)tex_ids[i]);
+
+            // Left, top, right, bottom
+            __m128 corners = _mm_add_ps(_mm_movelh_ps(position, position), _mm_mul_ps(_mm_movelh_ps(size, size), corner_sign));
+
+            __m128 z_r = _mm_unpacklo_ps(depth, color);
+            __m128 a_u = _mm_shuffle_ps(color, rect, _MM_SHUFFLE(2, 0, 3, 3));
+            __m128 v_id = _mm_unpacklo_ps(_mm_shuffle_ps(rect, rect, _MM_SHUFFLE(3, 1, 3, 1)), id);
+            __m128 z_rgb = _mm_shuffle_ps(z_r, color, _MM_SHUFFLE(2, 1, 1, 0));
+
+            __m128 q0 = _mm_shuffle_ps(corners, z_r, _MM_SHUFFLE(1, 0, 1, 0));
+            __m128 q1 = _mm_shuffle_ps(color, a_u, _MM_SHUFFLE(2, 0, 2, 1));
+            __m128 q2 = _mm_shuffle_ps(v_id, corners, _MM_SHUFFLE(1, 2, 3, 2));
+            __m128 q4 = _mm_shuffle_ps(a_u, v_id, _MM_SHUFFLE(3, 2, 3, 0));
+            __m128 q5 = _mm_shuffle_ps(corners, z_r, _MM_SHUFFLE(1, 0, 3, 2));
+            __m128 q6 = _mm_shuffle_ps(color, a_u, _MM_SHUFFLE(3, 0, 2, 1));
+            __m128 q7 = _mm_shuffle_ps(v_id, corners, _MM_SHUFFLE(3, 0, 1, 0));
+            __m128 q9 = _mm_shuffle_ps(a_u, v_id, _MM_SHUFFLE(1, 0, 2, 0));
+
+            // Spelled out so the quad stays in registers instead of going through the stack
+            if (non_temporal)
+            {
+                _mm_stream_ps(out, q0);
+                _mm_stream_ps(out + 4, q1);
+                _mm_stream_ps(out + 8, q2);
+                _mm_stream_ps(out + 12, z_rgb);
+                _mm_stream_ps(out + 16, q4);
+                _mm_stream_ps(out + 20, q5);
+                _mm_stream_ps(out + 24, q6);
+                _mm_stream_ps(out + 28, q7);
+                _mm_stream_ps(out + 32, z_rgb);
+                _mm_stream_ps(out + 36, q9);
+            }
+            else
+            {
+                _mm_storeu_ps(out, q0);
+                _mm_storeu_ps(out + 4, q1);
+                _mm_storeu_ps(out + 8, q2);
+                _mm_storeu_ps(out + 12, z_rgb);
+                _mm_storeu_ps(out + 16, q4);
+                _mm_storeu_ps(out + 20, q5);
+                _mm_storeu_ps(out + 24, q6);
+                _mm_storeu_ps(out + 28, q7);
+                _mm_storeu_ps(out + 32, z_rgb);
+                _mm_storeu_ps(out + 36, q9);
+            }
+        }
+
+        if (non_temporal)
+            _mm_sfence();
+
+        batch->quads.count += count;
+        return;
+    }
+#endif
+
+    Vec2 uv[4];
+    for (; i < count; i++)
+    {
+        batch_rect_uv(uv_rects ? uv_rects[i] : full, uv);
+        batch_push_quad(batch, positions[i], sizes[i], uv, colors ? colors[i] : white, tex_ids[i]);
+    }
+}
+
+void batch_rect_uv(Vec4 rect, Vec2 uv[4])
+{
+    // Same corner order as batch_add_sprite, rect goes from (3) to (1)
+    uv[0] = (Vec2){rect.x, rect.w};
+    uv[1] = (Vec2){rect.z, rect.w};
+    uv[2] = (Vec2){rect.z, rect.y};
+    uv[3] = (Vec2){rect.x, rect.y};
+}
+
+void batch_push_line_quad(Batch *batch, const LineQuad *quad, Vec4 color)
+{
+    if (!batch_reserve(batch, &batch->lines, 1))
+        return;
+
+    // Lines are expanded before the batch transform, so it scales their width too
+    const Vec2 *points = quad->points;
+    Vec2 transformed[4];
+    int i;
+    if (batch->transformed)
+    {
+        for (i = 0; i < 4; i++)
+            transformed[i] = transform2d_apply(batch->transform, points[i]);
+
+        points = transformed;
+    }
+
+    if (batch_clip_rejects(batch, points, 4))
+        return;
+
+    if (batch->flags & BATCH_COMPACT)
+    {
+        CompactLineVertex *vertices = (CompactLineVertex *)batch->lines.data + batch->lines.count * 4;
+
+        for (i = 0; i < 4; i++)
+        {
+            vertices[i].position = points[i];
+            vertices[i].color[0] = pack_unorm8(color.x);
+            vertices[i].color[1] = pack_unorm8(color.y);
+            vertices[i].color[2] = pack_unorm8(color.z);
+            vertices[i].color[3] = pack_unorm8(color.w);
+            vertices[i].edge = quad->edges[i];
+        }
+    }
+    else
+    {
+        LineVertex *vertices = (LineVertex *)batch->lines.data + batch->lines.count * 4;
+
+        for (i = 0; i < 4; i++)
+            vertices[i] = (LineVertex){{points[i].x, points[i].y, 0}, color, quad->edges[i]};
+    }
+
+    batch->lines.count++;
+}
+
+unsigned int batch_expand_polyline(const Vec2 *points, unsigned int count, float width, bool closed, LineJoin join, LineCap cap, LineQuad **quads, unsigned int *max_quads, unsigned int num_quads)
+{
+    if (count < 2)
+        return num_quads;
+
+    // Two points can't enclose anything, so only join them once
+    if (count < 3)
+        closed = false;
+
+    float inner = width / 2.0f;
+    float outer = inner + BATCH_LINE_FEATHER;
+    unsigned int num_segments = closed ? count : count - 1;
+
+    // How far butt and square caps reach past the end point, round caps are
+    // a fan that starts at it
+    float reach = cap == LINE_CAP_ROUND ? -1.0f : BATCH_LINE_FEATHER;
+    if (cap == LINE_CAP_SQUARE)
+        reach += inner;
+
+    unsigned int cap_steps = (unsigned int)((float)M_PI * outer / 3.0f) + 1;
+
+    unsigned int i;
+    for (i = 0; i < num_segments; i++)
+    {
+        Vec2 start = points[i];
+        Vec2 end = points[(i + 1) % count];
+        Vec2 direction = batch_line_direction(points, count, i, closed);
+        Vec2 normal = {-direction.y, direction.x};
+        bool has_start = closed || i > 0;
+        bool has_end = closed || i + 1 < num_segments;
+
+        // Corner offsets in the order the quad is built: start left, end
+        // left, end right, start right
+        Vec2 offsets[4];
+        offsets[0] = offsets[1] = normal;
+        offsets[2] = offsets[3] = (Vec2){-normal.x, -normal.y};
+
+        // Both segments end on the miter line when it fits. Other joins only
+        // share the inner miter corner and fill the outside with a fan from
+        // the point, so nothing is covered twice. Turns too sharp for that
+        // keep square ends, which overlap on the inside
+        if (has_start)
+        {
+            Vec2 in = batch_line_direction(points, count, (i + num_segments - 1) % num_segments, closed);
+            float turn = vec2_cross(in, direction);
+            Vec2 offset;
+            bool mitered = batch_line_miter(in, direction, &offset);
+
+            if (mitered && join == LINE_JOIN_MITER)
+            {
+                offsets[0] = offset;
+                offsets[3] = (Vec2){-offset.x, -offset.y};
+            }
+            else
+            {
+                Vec2 from = turn > 0 ? (Vec2){in.y, -in.x} : (Vec2){-in.y, in.x};
+                float sweep = atan2f(turn, vec2_dot(in, direction));
+                unsigned int steps = join == LINE_JOIN_ROUND ? (unsigned int)(fabsf(sweep) * outer / 3.0f) + 1 : 1;
+                Vec2 corner;
+
+                if (mitered)
+                {
+                    if (turn > 0)
+                        offsets[0] = offset;
+                    else
+                        offsets[3] = (Vec2){-offset.x, -offset.y};
+
+                    corner = vec2_add(start, vec2_scale(turn > 0 ? offsets[0] : offsets[3], outer));
+                }
+
+                num_quads = batch_expand_line_fan(start, mitered ? &corner : NULL, from, sweep, steps, outer, quads, max_quads, num_quads);
+            }
+        }
+        else if (reach < 0)
+        {
+            num_quads = batch_expand_line_fan(start, NULL, (Vec2){direction.y, -direction.x}, -(float)M_PI, cap_steps, outer, quads, max_quads, num_quads);
+        }
+
+        if (has_end)
+        {
+            Vec2 out = batch_line_direction(points, count, (i + 1) % num_segments, closed);
+            float turn = vec2_cross(direction, out);
+            Vec2 offset;
+
+            if (batch_line_miter(direction, out, &offset))
+            {
+                if (join == LINE_JOIN_MITER || turn > 0)
+                    offsets[1] = offset;
+
+                if (join == LINE_JOIN_MITER || turn <= 0)
+                    offsets[2] = (Vec2){-offset.x, -offset.y};
+            }
+        }
+        else if (reach < 0)
+        {
+            num_quads = batch_expand_line_fan(end, NULL, normal, -(float)M_PI, cap_steps, outer, quads, max_quads, num_quads);
+        }
+
+        num_quads = batch_expand_line_segment(start, end, offsets, has_start ? -1.0f : reach, has_end ? -1.0f : reach, outer, quads, max_quads, num_quads);
+    }
+
+    return num_quads;
+}
+
+unsigned int batch_expand_line_segment(Vec2 start, Vec2 end, const Vec2 offsets[4], float start_cap, float end_cap, float outer, LineQuad **quads, unsigned int *max_quads, unsigned int num_quads)
+{
+    batch_grow_line_quads(quads, max_quads, num_quads + 1);
+
+    Vec2 direction = vec2_normalize(vec2_sub(end, start));
+    Vec2 *points = (*quads)[num_quads].points;
+    Vec4 *edges = (*quads)[num_quads].edges;
+
+    // Capped ends reach past their point by the cap and fade out over its
+    // last unit, joined ends stop at the point and leave the fading to the join
+    Vec2 from = start_cap > 0 ? vec2_sub(start, vec2_scale(direction, start_cap)) : start;
+    Vec2 to = end_cap > 0 ? vec2_add(end, vec2_scale(direction, end_cap)) : end;
+
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        points[i] = vec2_add(i == 0 || i == 3 ? from : to, vec2_scale(offsets[i], outer));
+
+        edges[i].x = i < 2 ? outer : -outer;
+        edges[i].y = outer;
+        edges[i].z = start_cap < 0 ? BATCH_LINE_FEATHER : vec2_dot(vec2_sub(points[i], from), direction);
+        edges[i].w = end_cap < 0 ? BATCH_LINE_FEATHER : vec2_dot(vec2_sub(to, points[i]), direction);
+    }
+
+    return num_quads + 1;
+}
+
+unsigned int batch_expand_line_fan(Vec2 center, const Vec2 *corner, Vec2 from, float sweep, unsigned int steps, float outer, LineQuad **quads, unsigned int *max_quads, unsigned int num_quads)
+{
+    // The rim is the arc, closed off on both sides by the inner corner when
+    // there is one. Its triangles with the center go out two to a quad
+    unsigned int count = steps + 1 + (corner ? 2 : 0);
+
+    batch_grow_line_quads(quads, max_quads, num_quads + count / 2);
+
+    unsigned int i;
+    int j;
+    for (i = 0; i + 1 < count; i += 2)
+    {
+        Vec2 *points = (*quads)[num_quads].points;
+        Vec4 *edges = (*quads)[num_quads].edges;
+
+        points[0] = center;
+        edges[0] = (Vec4){0, outer, BATCH_LINE_FEATHER, BATCH_LINE_FEATHER};
+
+        for (j = 1; j < 4; j++)
+        {
+            unsigned int rim = i + (unsigned int)j - 1;
+            if (rim >= count)
+                rim = count - 1;
+
+            // The corner sits on the far edge of both segments, so it fades
+            // the same way across them
+            if (corner && (rim == 0 || rim == count - 1))
+            {
+                points[j] = *corner;
+                edges[j] = (Vec4){-outer, outer, BATCH_LINE_FEATHER, BATCH_LINE_FEATHER};
+            }
+            else
+            {
+                unsigned int step = corner ? rim - 1 : rim;
+
+                points[j] = vec2_add(center, vec2_scale(vec2_rotate(from, sweep * (float)step / (float)steps), outer));
+                edges[j] = (Vec4){outer, outer, BATCH_LINE_FEATHER, BATCH_LINE_FEATHER};
+            }
+        }
+
+        num_quads++;
+    }
+
+    return num_quads;
+}
+
+void batch_grow_line_quads(LineQuad **quads, unsigned int *max_quads, unsigned int count)
+{
+    if (count <= *max_quads)
+        return;
+
+    while (count > *max_quads)
+        *max_quads = *max_quads ? *max_quads * 2 : 64;
+
+    *quads = realloc(*quads, *max_quads * sizeof(LineQuad));
+}
+
+Vec2 batch_line_direction(const Vec2 *points, unsigned int count, unsigned int segment, bool closed)
+{
+    unsigned int next = closed ? (segment + 1) % count : segment + 1;
+
+    return vec2_normalize(vec2_sub(points[next], points[segment]));
+}
+
+bool batch_line_miter(Vec2 in, Vec2 out, Vec2 *offset)
+{
+    Vec2 normal = vec2_normalize((Vec2){-in.y - out.y, in.x + out.x});
+    float scale = vec2_dot(normal, (Vec2){-in.y, in.x});
+
+    // Sharp turns would throw the corner far past the line, so bevel those
+    if (scale * BATCH_LINE_MITER_LIMIT < 1.0f)
+        return false;
+
+    *offset = vec2_scale(normal, 1.0f / scale);
+    return true;
+}
+
+void batch_push_shape(Batch *batch, Vec2 center, Vec2 half_size, float radius, float thickness, float arc_angle, float arc_half_sweep, Vec4 color)
+{
+    // Leave room past the edge for the fade, the shader works in local units
+    float x = half_size.x + BATCH_SHAPE_FEATHER;
+    float y = half_size.y + BATCH_SHAPE_FEATHER;
+    Vec2 local[4] = {{-x, y}, {x, y}, {x, -y}, {-x, -y}};
+    Vec2 positions[4];
+
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        positions[i] = vec2_add(center, local[i]);
+
+        if (batch->transformed)
+            positions[i] = transform2d_apply(batch->transform, positions[i]);
+    }
+
+    if (batch_clip_rejects(batch, positions, 4) || !batch_reserve(batch, &batch->shapes, 1))
+        return;
+
+    ShapeVertex *vertices = (ShapeVertex *)batch->shapes.data + batch->shapes.count * 4;
+
+    for (i = 0; i < 4; i++)
+    {
+        vertices[i].position = (Vec3){positions[i].x, positions[i].y, batch->depth};
+        vertices[i].color = color;
+        vertices[i].local = local[i];
+        vertices[i].shape = (Vec4){half_size.x, half_size.y, radius, thickness};
+        vertices[i].arc = (Vec2){arc_angle, arc_half_sweep};
+    }
+
+    batch->shapes.count++;
+}
+
+void batch_push_quad_transformed(Batch *batch, const Transform2D *transform, const Vec2 uv[4], Vec4 color, unsigned int tex_id)
+{
+    void *out = (unsigned char *)batch->quads.data + batch->quads.count * batch->quads.size;
+
+    batch_write_quad_transformed(out, batch->flags, batch->depth, transform, uv, color, tex_id);
+    batch->quads.count++;
+}
+
+void batch_write_quad_transformed(void *out, unsigned int flags, float depth, const Transform2D *transform, const Vec2 uv[4], Vec4 color, unsigned int tex_id)
+{
+    if (transform->m01 == 0 && transform->m10 == 0)
+    {
+        batch_write_quad(out, flags, depth, (Vec2){transform->m02, transform->m12}, (Vec2){transform->m00, transform->m11}, uv, color, tex_id);
+        return;
+    }
+
+    if (flags & BATCH_INSTANCED)
+    {
+        // Keep the rotation and the size along each axis, shear has no place
+        // in an instance
+        float width = sqrtf(transform->m00 * transform->m00 + transform->m10 * transform->m10);
+        float height = (transform->m00 * transform->m11 - transform->m01 * transform->m10) / width;
+
+        batch_write_quad(out, flags, depth, (Vec2){transform->m02, transform->m12}, (Vec2){width, height}, uv, color, tex_id);
+        ((QuadInstance *)out)->rotation = atan2f(transform->m10, transform->m00);
+        return;
+    }
+
+    // The corners are the center plus or minus half of each axis
+    Vec2 center = {transform->m02, transform->m12};
+    Vec2 x_axis = {transform->m00 * 0.5f, transform->m10 * 0.5f};
+    Vec2 y_axis = {transform->m01 * 0.5f, transform->m11 * 0.5f};
+
+    Vec2 corners[4];
+    corners[0] = (Vec2){center.x - x_axis.x + y_axis.x, center.y - x_axis.y + y_axis.y};
+    corners[1] = (Vec2){center.x + x_axis.x + y_axis.x, center.y + x_axis.y + y_axis.y};
+    corners[2] = (Vec2){center.x + x_axis.x - y_axis.x, center.y + x_axis.y - y_axis.y};
+    corners[3] = (Vec2){center.x - x_axis.x - y_axis.x, center.y - x_axis.y - y_axis.y};
+
+    int i;
+    if (flags & BATCH_COMPACT)
+    {
+        CompactQuadVertex *vertices = out;
+        unsigned char packed[4] = {pack_unorm8(color.x), pack_unorm8(color.y), pack_unorm8(color.z), pack_unorm8(color.w)};
+
+        for (i = 0; i < 4; i++)
+        {
+            vertices[i].position = corners[i];
+            memcpy(vertices[i].color, packed, 4);
+            vertices[i].tex_coord[0] = pack_unorm16(uv[i].x);
+            vertices[i].tex_coord[1] = pack_unorm16(uv[i].y);
+            vertices[i].tex_id = (unsigned short)tex_id;
+            vertices[i].depth = pack_snorm16(depth);
+        }
+    }
+    else
+    {
+        QuadVertex *vertices = out;
+
+        for (i = 0; i < 4; i++)
+            vertices[i] = (QuadVertex){{corners[i].x, corners[i].y, depth}, color, uv[i], (float)tex_id};
+    }
+}
+
+void batch_bind_instances(Batch *batch, unsigned int offset)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, batch->quads.vbo);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void *)(offset + offsetof(QuadInstance, center)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void *)(offset + offsetof(QuadInstance, half_size)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(QuadInstance), (void *)(offset + offsetof(QuadInstance, rotation)));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(QuadInstance), (void *)(offset + offsetof(QuadInstance, color)));
+    glVertexAttribPointer(4, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuadInstance), (void *)(offset + offsetof(QuadInstance, tex_rect)));
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(QuadInstance), (void *)(offset + offsetof(QuadInstance, tex_id)));
+
+    int i;
+    for (i = 0; i < 6; i++)
+    {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
+
+bool batch_freeze(Batch *batch)
+{
+    if (batch->frozen || (batch->flags & BATCH_STREAMING))
+        return false;
+
+    if (batch->flags & BATCH_DEFERRED)
+        batch_flush_commands(batch);
+
+    // Nothing keeps evicted glyphs from being replaced under a frozen batch
+    if (batch->cached_glyphs)
+        return false;
+
+    batch_close_draw(batch, &batch->quads);
+    batch_close_draw(batch, &batch->lines);
+    batch_close_draw(batch, &batch->shapes);
+
+    // Patched quads keep the depth they were added with, and so their place in the depth passes
+    if (!(batch->flags & BATCH_INSTANCED))
+    {
+        batch->frozen_depths = malloc(batch->quads.count * sizeof(float));
+
+        unsigned int i;
+        for (i = 0; i < batch->quads.count; i++)
+        {
+            if (batch->flags & BATCH_COMPACT)
+                batch->frozen_depths[i] = ((CompactQuadVertex *)batch->quads.data)[4 * i].depth / 32767.0f;
+            else
+                batch->frozen_depths[i] = ((QuadVertex *)batch->quads.data)[4 * i].position.z;
+        }
+    }
+
+    batch_stream_freeze(&batch->quads);
+    batch_stream_freeze(&batch->lines);
+    batch_stream_freeze(&batch->shapes);
+
+    free(batch->commands);
+    free(batch->sort_entries);
+    free(batch->sort_scratch);
+    batch->commands = NULL;
+    batch->sort_entries = NULL;
+    batch->sort_scratch = NULL;
+    batch->num_commands = batch->max_commands = 0;
+
+    batch->frozen = true;
+    return true;
+}
+
+void batch_stream_freeze(BatchStream *stream)
+{
+    // Upload everything once and let the driver place it in static memory
+    glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+    glBufferData(GL_ARRAY_BUFFER, (long)(stream->count * stream->size), stream->data, GL_STATIC_DRAW);
+    stream->buffer_capacity = stream->count;
+
+    free(stream->data);
+    stream->data = NULL;
+}
+
+bool batch_update_quad(Batch *batch, unsigned int index, Vec2 position, Vec2 size, Vec2 uv[4], Vec4 color, Texture *texture)
+{
+    if (!batch->frozen || index >= batch->quads.count)
+        return false;
+
+    // Find the draw holding the quad, its texture set ends where the next one starts
+    unsigned int i, first = 0, end = batch->texture_base + batch->num_textures;
+    for (i = 0; i < batch->quads.num_draws; i++)
+    {
+        BatchDraw *draw = &batch->quads.draws[i];
+
+        if (index < draw->offset / batch->quads.size + draw->count)
+        {
+            first = draw->texture_base;
+
+            for (; i < batch->quads.num_draws; i++)
+            {
+                if (batch->quads.draws[i].texture_base != first)
+                {
+                    end = batch->quads.draws[i].texture_base;
+                    break;
+                }
+            }
+
+            break;
+        }
+    }
+
+    unsigned int tex_id = batch->white_id;
+
+    if (texture)
+    {
+        Texture *binding = texture;
+
+        if (batch->flags & BATCH_TEXTURE_ARRAYS)
+            binding = texture->array;
+
+        // The quad can only use textures that are already bound for its draw
+        for (i = first; i < end; i++)
+        {
+            if (batch->textures[i] == binding)
+                break;
+        }
+
+        if (!binding || i == end)
+            return false;
+
+        tex_id = batch->flags & BATCH_TEXTURE_ARRAYS ? (i - first) << 8 | texture->layer : i - first;
+    }
+
+    float depth = batch->frozen_depths ? batch->frozen_depths[index] : 0.0f;
+    unsigned char vertices[4 * sizeof(QuadVertex)];
+
+    batch_write_quad(vertices, batch->flags, depth, position, size, uv, batch_blend_color(batch, color), tex_id);
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch->quads.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (long)(index * batch->quads.size), batch->quads.size, vertices);
+    return true;
+}
+
+void batch_set_layer(Batch *batch, unsigned int layer)
+{
+    batch->layer = layer > 0xFF ? 0xFF : layer;
+}
+
+void batch_set_depth(Batch *batch, float depth)
+{
+    batch->depth = depth;
+}
+
+void batch_set_blend_mode(Batch *batch, BlendMode mode)
+{
+    if (mode == batch->blend)
+        return;
+
+    // Premultiplied batches draw every mode but multiply with the same state
+    bool merged = (batch->flags & BATCH_PREMULTIPLIED_ALPHA) && mode != BLEND_MULTIPLY && batch->blend != BLEND_MULTIPLY;
+
+    if (!merged)
+        batch_close_draw(batch, &batch->quads);
+
+    batch_close_draw(batch, &batch->lines);
+    batch_close_draw(batch, &batch->shapes);
+
+    batch->blend = mode;
+}
+
+BatchStats batch_get_stats(Batch *batch)
+{
+    return batch->stats;
+}
+
+void batch_reset_stats(Batch *batch)
+{
+    batch->stats = (BatchStats){ 0 };
+}
+
+void batch_begin_parallel(Batch *batch, unsigned int num_recorders)
+{
+    if (batch->recording)
+        batch_end_parallel(batch);
+
+    // Merged quads would skip the sorted command stream and the depth pass split
+    if (batch->flags & (BATCH_DEFERRED | BATCH_DEPTH_PASSES))
+        return;
+
+    if (num_recorders > batch->max_recorders)
+    {
+        batch->recorders = realloc(batch->recorders, num_recorders * sizeof(BatchRecorder));
+        memset(batch->recorders + batch->max_recorders, 0, (num_recorders - batch->max_recorders) * sizeof(BatchRecorder));
+        batch->max_recorders = num_recorders;
+    }
+
+    // Recorders keep their slabs between frames and only rewind them
+    unsigned int i;
+    for (i = 0; i < num_recorders; i++)
+    {
+        BatchRecorder *recorder = &batch->recorders[i];
+
+        recorder->batch = batch;
+        recorder->num_quads = 0;
+        recorder->num_textures = 0;
+        recorder->last_texture = NULL;
+        recorder->last_index = 0;
+        recorder->depth = batch->depth;
+    }
+
+    batch->num_recorders = num_recorders;
+    batch->recording = true;
+}
+
+BatchRecorder *batch_get_recorder(Batch *batch, unsigned int index)
+{
+    if (!batch->recording || index >= batch->num_recorders)
+        return NULL;
+
+    return &batch->recorders[index];
+}
+
+void batch_end_parallel(Batch *batch)
+{
+    if (!batch->recording)
+        return;
+
+    batch->recording = false;
+
+    unsigned int i;
+    for (i = 0; i < batch->num_recorders; i++)
+        batch_merge_recorder(batch, &batch->recorders[i]);
+}
+
+void batch_recorder_add_sprite(BatchRecorder *recorder, Vec2 position, Vec2 size, Texture *texture)
+{
+    static const Vec2 uv[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
+
+    batch_recorder_add_sprite_uv(recorder, position, size, (Vec2 *)uv, texture);
+}
+
+void batch_recorder_add_sprite_uv(BatchRecorder *recorder, Vec2 position, Vec2 size, Vec2 uv[4], Texture *texture)
+{
+    void *out = batch_recorder_next(recorder, texture);
+
+    batch_write_quad(out, recorder->batch->flags, recorder->depth, position, size, uv, (Vec4){1, 1, 1, 1}, 0);
+}
+
+void batch_recorder_add_quad(BatchRecorder *recorder, Vec2 position, Vec2 size, Vec4 color)
+{
+    static const Vec2 uv[4] = {{0, 1}, {1, 1}, {1, 0}, {0, 0}};
+
+    void *out = batch_recorder_next(recorder, NULL);
+
+    batch_write_quad(out, recorder->batch->flags, recorder->depth, position, size, uv, color, 0);
+}
+
+void batch_recorder_add_sprite_transformed(BatchRecorder *recorder, Transform2D transform, Vec2 uv[4], Vec4 color, Texture *texture)
+{
+    void *out = batch_recorder_next(recorder, texture);
+
+    batch_write_quad_transformed(out, recorder->batch->flags, recorder->depth, &transform, uv, color, 0);
+}
+
+void batch_recorder_set_depth(BatchRecorder *recorder, float depth)
+{
+    recorder->depth = depth;
+}
+
+void *batch_recorder_next(BatchRecorder *recorder, Texture *texture)
+{
+    Batch *batch = recorder->batch;
+
+    if (recorder->num_quads == recorder->quad_capacity)
+    {
+        recorder->quad_capacity = recorder->quad_capacity ? recorder->quad_capacity * 2 : batch->max_draw_elements;
+        recorder->quad_data = realloc(recorder->quad_data, recorder->quad_capacity * batch->quads.size);
+        recorder->texture_indices = realloc(recorder->texture_indices, recorder->quad_capacity * sizeof(unsigned int));
+    }
+
+    // Slots belong to the batch, so only remember which texture each quad
+    // wants (0 for none) and resolve the slot when merging
+    unsigned int index = 0;
+
+    if (texture && texture == recorder->last_texture)
+    {
+        index = recorder->last_index;
+    }
+    else if (texture)
+    {
+        unsigned int i;
+        for (i = 0; i < recorder->num_textures; i++)
+        {
+            if (recorder->textures[i] == texture)
+                break;
+        }
+
+        if (i == recorder->num_textures)
+        {
+            if (recorder->num_textures == recorder->max_textures)
+            {
+                recorder->max_textures = recorder->max_textures ? recorder->max_textures * 2 : BATCH_MAX_TEXTURES;
+                recorder->textures = realloc(recorder->textures, recorder->max_textures * sizeof(Texture *));
+            }
+
+            recorder->textures[recorder->num_textures++] = texture;
+        }
+
+        index = i + 1;
+        recorder->last_texture = texture;
+        recorder->last_index = index;
+    }
+
+    recorder->texture_indices[recorder->num_quads] = index;
+    return (unsigned char *)recorder->quad_data + recorder->num_quads++ * batch->quads.size;
+}
+
+void batch_merge_recorder(Batch *batch, BatchRecorder *recorder)
+{
+    unsigned char *data = recorder->quad_data;
+    unsigned int size = batch->quads.size;
+
+    unsigned int first = 0;
+    while (first < recorder->num_quads)
+    {
+        unsigned int count = recorder->num_quads - first;
+        unsigned int room = batch_draw_room(batch);
+
+        if (count > room)
+            count = room;
+
+        if (!batch_reserve(batch, &batch->quads, count))
+        {
+            first += count;
+            continue;
+        }
+
+        // Patch in the slots and copy the quads over in runs, a run ending
+        // before any lookup that could split the draw (like the bulk path)
+        unsigned int i, run = first;
+        for (i = first; i < first + count; i++)
+        {
+            unsigned int index = recorder->texture_indices[i];
+            int slot = (int)batch->white_id;
+
+            if (index)
+            {
+                Texture *texture = recorder->textures[index - 1];
+
+                if (texture != batch->last_texture && batch->num_textures >= batch->max_textures)
+                {
+                    batch_copy_quads(batch, data + run * size, i - run);
+                    run = i;
+                }
+
+                slot = batch_texture_slot(batch, texture);
+
+                if (slot < 0)
+                {
+                    batch_copy_quads(batch, data + run * size, i - run);
+                    run = i + 1;
+                    continue;
+                }
+            }
+
+            batch_write_tex_id(data + i * size, batch->flags, (unsigned int)slot);
+        }
+
+        batch_copy_quads(batch, data + run * size, i - run);
+        first += count;
+    }
+}
+
+void batch_copy_quads(Batch *batch, const void *quads, unsigned int count)
+{
+    memcpy((unsigned char *)batch->quads.data + batch->quads.count * batch->quads.size, quads, count * batch->quads.size);
+    batch->quads.count += count;
+}
+
+/*********************************************************
+ *                 STREAM BUFFER FUNCTIONS               *
+ *********************************************************/
+
+void stream_buffer_create(StreamBuffer *stream, unsigned int region_size, unsigned int num_regions)
+{
+    long size = (long)region_size * num_regions;
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    stream->region_size = region_size;
+    stream->num_regions = num_regions;
+    stream->region = 0;
+    stream->first = 0;
+    stream->mapped = NULL;
+    memset(stream->fences, 0, sizeof(stream->fences));
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+
+    if (graphics.buffer_storage)
+    {
+        graphics.buffer_storage(GL_ARRAY_BUFFER, size, NULL, access);
+        stream->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, size, access);
+
+        // Immutable storage can't be respecified, so start over with a fresh buffer
+        if (!stream->mapped)
+        {
+            glDeleteBuffers(1, &stream->buffer);
+            glGenBuffers(1, &stream->buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+        }
+    }
+
+    stream->persistent = stream->mapped != NULL;
+
+    if (!stream->persistent)
+        glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+}
+
+void stream_buffer_destroy(StreamBuffer *stream)
+{
+    unsigned int i;
+    for (i = 0; i < stream->num_regions; i++)
+    {
+        if (stream->fences[i])
+            glDeleteSync(stream->fences[i]);
+    }
+
+    // Deleting the buffer also releases any mapping still held on it
+    glDeleteBuffers(1, &stream->buffer);
+}
+
+void *stream_buffer_map(StreamBuffer *stream, BatchStats *stats)
+{
+    // Without buffer storage a new submission starting the ring over orphans
+    // the whole buffer, which also makes every older fence irrelevant
+    bool orphan = !stream->persistent && stream->region == 0 && stream->first == 0;
+    long offset = (long)stream->region * stream->region_size;
+
+    unsigned int i;
+    for (i = 0; i < stream->num_regions; i++)
+    {
+        GLsync fence = stream->fences[i];
+
+        if (!fence || (!orphan && i != stream->region))
+            continue;
+
+        // Only block (and report it) when the GPU is still reading this region
+        if (!orphan && glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            double start = glfwGetTime();
+
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+
+            stats->fence_waits++;
+            stats->fence_wait_time += glfwGetTime() - start;
+        }
+
+        glDeleteSync(fence);
+        stream->fences[i] = NULL;
+    }
+
+    if (stream->persistent)
+        return stream->mapped + offset;
+
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+    access |= orphan ? GL_MAP_INVALIDATE_BUFFER_BIT : GL_MAP_INVALIDATE_RANGE_BIT;
+
+    glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+    return glMapBufferRange(GL_ARRAY_BUFFER, offset, stream->region_size, access);
+}
+
+void *stream_buffer_next(StreamBuffer *stream, unsigned int size, BatchStats *stats)
+{
+    // Every region is already holding data for the current submission
+    if ((stream->region + 1) % stream->num_regions == stream->first)
+        return NULL;
+
+    stream_buffer_unmap(stream, size);
+    stream->region = (stream->region + 1) % stream->num_regions;
+
+    return stream_buffer_map(stream, stats);
+}
+
+unsigned int stream_buffer_unmap(StreamBuffer *stream, unsigned int size)
+{
+    if (!stream->persistent)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, stream->buffer);
+
+        if (size)
+            glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, size);
+
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    return stream->region * stream->region_size;
+}
+
+void stream_buffer_fence(StreamBuffer *stream)
+{
+    // One fence per region used by this submission
+    unsigned int region = stream->first;
+    for (;;)
+    {
+        stream->fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        if (region == stream->region)
+            break;
+
+        region = (region + 1) % stream->num_regions;
+    }
+
+    stream->region = (stream->region + 1) % stream->num_regions;
+    stream->first = stream->region;
+}
+
+/*********************************************************
  *                     FONT FUNCTIONS                    *
  *********************************************************/
 
-Font *font_load_from_file(const char *path, float font_size)
+Font *font_load_from_file(const char *path, float font_size)
+{
+    FontRange ascii = {32, 96};
+
+    return font_load_packed(path, font_size, &ascii, 1, 1, 1);
+}
+
+Font *font_load_packed(const char *path, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y)
+{
+    unsigned char *bytes = utils_read_file_bytes(path);
+
+    if (!bytes)
+        return 0;
+
+    Font *font = font_bake(bytes, font_size, ranges, num_ranges, oversample_x, oversample_y, NULL);
+
+    free(bytes);
+    return font;
+}
+
+Font *font_load_cached(const char *path, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y, const char *cache_path)
+{
+    size_t length;
+    unsigned char *bytes = utils_read_file_sized(path, &length);
+
+    if (!bytes)
+        return 0;
+
+    FontCacheKey key;
+    key.hash = font_cache_hash(bytes, length);
+    key.size = font_size;
+    key.oversample_x = font_clamp_oversample(oversample_x);
+    key.oversample_y = font_clamp_oversample(oversample_y);
+    key.num_ranges = num_ranges;
+
+    Font *font = font_cache_read(cache_path, &key, ranges);
+
+    if (!font)
+    {
+        unsigned char *pixels;
+        font = font_bake(bytes, font_size, ranges, num_ranges, oversample_x, oversample_y, &pixels);
+
+        if (font)
+        {
+            font_cache_write(cache_path, &key, font, pixels);
+            free(pixels);
+        }
+    }
+
+    free(bytes);
+    return font;
+}
+
+Font *font_bake(const unsigned char *bytes, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y, unsigned char **atlas)
+{
+    stbtt_fontinfo info;
+
+    if (!stbtt_InitFont(&info, bytes, stbtt_GetFontOffsetForIndex(bytes, 0)))
+        return 0;
+
+    oversample_x = font_clamp_oversample(oversample_x);
+    oversample_y = font_clamp_oversample(oversample_y);
+
+    Font *font = calloc(1, sizeof(Font));
+
+    font->size = font_size;
+    font->scale = stbtt_ScaleForPixelHeight(&info, font_size);
+    font->oversample_x = oversample_x;
+    font->oversample_y = oversample_y;
+    font->num_ranges = num_ranges;
+    font->ranges = malloc(num_ranges * sizeof(FontRange));
+    memcpy(font->ranges, ranges, num_ranges * sizeof(FontRange));
+
+    unsigned int count = 0, i;
+    for (i = 0; i < num_ranges; i++)
+        count += ranges[i].count;
+
+    font->character_data = calloc(count ? count : 1, sizeof(Character));
+
+    stbtt_pack_range *pack_ranges = calloc(num_ranges ? num_ranges : 1, sizeof(stbtt_pack_range));
+    stbrp_rect *rects = malloc((count ? count : 1) * sizeof(stbrp_rect));
+    stbrp_rect *sorted = malloc((count ? count : 1) * sizeof(stbrp_rect));
+    stbrp_rect *best = malloc((count ? count : 1) * sizeof(stbrp_rect));
+
+    for (i = 0, count = 0; i < num_ranges; i++)
+    {
+        pack_ranges[i].font_size = font_size;
+        pack_ranges[i].first_unicode_codepoint_in_range = ranges[i].first;
+        pack_ranges[i].num_chars = ranges[i].count;
+        pack_ranges[i].chardata_for_range = (stbtt_packedchar *)font->character_data + count;
+        count += ranges[i].count;
+    }
+
+    // Only the padding and oversampling are needed to measure the glyphs
+    stbtt_pack_context context;
+    stbtt_PackBegin(&context, NULL, FONT_ATLAS_PADDING + 1, 1, 0, FONT_ATLAS_PADDING, NULL);
+    stbtt_PackSetOversampling(&context, oversample_x, oversample_y);
+    stbtt_PackSetSkipMissingCodepoints(&context, 1);
+    stbtt_PackFontRangesGatherRects(&context, &info, pack_ranges, num_ranges, rects);
+    stbtt_PackEnd(&context);
+
+    unsigned int area = 0, widest = 1;
+    for (i = 0; i < count; i++)
+    {
+        area += rects[i].w * rects[i].h;
+
+        if ((unsigned int)rects[i].w > widest)
+            widest = rects[i].w;
+    }
+
+    unsigned int width = 1, narrowest = 1;
+    while (width * width < area)
+        width *= 2;
+    while (narrowest < widest + FONT_ATLAS_PADDING)
+        narrowest *= 2;
+
+    // Shelves waste a little, so one size either side of the square can come out smaller
+    unsigned int best_width = 0, best_height = 0, candidate;
+    for (candidate = width / 2 > narrowest ? width / 2 : narrowest; candidate <= width * 2 || !best_width; candidate *= 2)
+    {
+        unsigned int height = 1, used = font_pack_rects(rects, count, candidate, FONT_ATLAS_PADDING, sorted);
+
+        while (height < used)
+            height *= 2;
+
+        // Of two equal areas the squarer one wastes less when rounded up
+        if (!best_width || candidate * height < best_width * best_height ||
+            (candidate * height == best_width * best_height && candidate <= best_height && height <= best_height))
+        {
+            best_width = candidate;
+            best_height = height;
+            memcpy(best, rects, count * sizeof(stbrp_rect));
+        }
+    }
+
+    unsigned char *pixels = malloc(best_width * best_height);
+
+    stbtt_PackBegin(&context, pixels, best_width, best_height, 0, FONT_ATLAS_PADDING, NULL);
+    stbtt_PackSetSkipMissingCodepoints(&context, 1);
+    stbtt_PackFontRangesRenderIntoRects(&context, &info, pack_ranges, num_ranges, best);
+    stbtt_PackEnd(&context);
+
+    font->bitmap = texture_load(pixels, best_width, best_height, 1);
+    font_load_metrics(font, &info);
+
+    if (atlas)
+        *atlas = pixels;
+    else
+        free(pixels);
+
+    free(best);
+    free(sorted);
+    free(rects);
+    free(pack_ranges);
+    return font;
+}
+
+unsigned int font_clamp_oversample(unsigned int oversample)
+{
+    if (oversample < 1)
+        return 1;
+    if (oversample > STBTT_MAX_OVERSAMPLE)
+        return STBTT_MAX_OVERSAMPLE;
+
+    return oversample;
+}
+
+unsigned long long font_cache_hash(const unsigned char *bytes, size_t length)
+{
+    unsigned long long hash = 14695981039346656037ull, word;
+    size_t i;
+
+    // FNV-1a a word at a time, the font file is hashed on every load
+    for (i = 0; i + 8 <= length; i += 8)
+    {
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+
+    for (; i < length; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+
+    return hash ^ length;
+}
+
+Font *font_cache_read(const char *cache_path, const FontCacheKey *key, const FontRange *ranges)
+{
+    size_t length;
+    unsigned char *data = utils_read_file_sized(cache_path, &length);
+
+    if (!data)
+        return 0;
+
+    FontCacheHeader header;
+    size_t offset = sizeof(FontCacheHeader);
+    unsigned int count = 0, i;
+
+    for (i = 0; i < key->num_ranges; i++)
+        count += ranges[i].count;
+
+    if (length < sizeof(FontCacheHeader))
+    {
+        free(data);
+        return 0;
+    }
+
+    memcpy(&header, data, sizeof(FontCacheHeader));
+
+    // Anything baked from another file, size, range list or by another version is baked again
+    size_t expected = offset + key->num_ranges * sizeof(FontRange) + count * sizeof(Character) +
+                      header.num_kerning * sizeof(FontKerningPair) + (size_t)header.width * header.height;
+
+    if (header.magic != FONT_CACHE_MAGIC || header.version != FONT_CACHE_VERSION || memcmp(&header.key, key, sizeof(FontCacheKey)) ||
+        length != expected || memcmp(data + offset, ranges, key->num_ranges * sizeof(FontRange)) ||
+        (header.num_kerning & (header.num_kerning - 1)))
+    {
+        free(data);
+        return 0;
+    }
+
+    offset += key->num_ranges * sizeof(FontRange);
+
+    Font *font = calloc(1, sizeof(Font));
+
+    font->size = key->size;
+    font->scale = header.scale;
+    font->oversample_x = key->oversample_x;
+    font->oversample_y = key->oversample_y;
+    font->ascent = header.ascent;
+    font->descent = header.descent;
+    font->line_gap = header.line_gap;
+    memcpy(font->advances, header.advances, sizeof(font->advances));
+
+    font->num_ranges = key->num_ranges;
+    font->ranges = malloc(key->num_ranges * sizeof(FontRange));
+    memcpy(font->ranges, ranges, key->num_ranges * sizeof(FontRange));
+
+    font->character_data = malloc((count ? count : 1) * sizeof(Character));
+    memcpy(font->character_data, data + offset, count * sizeof(Character));
+    offset += count * sizeof(Character);
+
+    if (header.num_kerning)
+    {
+        font->kerning = malloc(header.num_kerning * sizeof(FontKerningPair));
+        font->kerning_mask = header.num_kerning - 1;
+        memcpy(font->kerning, data + offset, header.num_kerning * sizeof(FontKerningPair));
+        offset += header.num_kerning * sizeof(FontKerningPair);
+    }
+
+    font->bitmap = texture_load(data + offset, header.width, header.height, 1);
+
+    free(data);
+    return font;
+}
+
+void font_cache_write(const char *cache_path, const FontCacheKey *key, Font *font, const unsigned char *pixels)
+{
+    FILE *file = fopen(cache_path, "wb");
+
+    if (!file)
+        return;
+
+    FontCacheHeader header;
+    memset(&header, 0, sizeof(FontCacheHeader));
+
+    header.magic = FONT_CACHE_MAGIC;
+    header.version = FONT_CACHE_VERSION;
+    header.key = *key;
+    header.width = font->bitmap->width;
+    header.height = font->bitmap->height;
+    header.num_kerning = font->kerning ? font->kerning_mask + 1 : 0;
+    header.scale = font->scale;
+    header.ascent = font->ascent;
+    header.descent = font->descent;
+    header.line_gap = font->line_gap;
+    memcpy(header.advances, font->advances, sizeof(header.advances));
+
+    unsigned int count = 0, i;
+    for (i = 0; i < font->num_ranges; i++)
+        count += font->ranges[i].count;
+
+    fwrite(&header, sizeof(FontCacheHeader), 1, file);
+    fwrite(font->ranges, sizeof(FontRange), font->num_ranges, file);
+    fwrite(font->character_data, sizeof(Character), count, file);
+    fwrite(font->kerning, sizeof(FontKerningPair), header.num_kerning, file);
+    fwrite(pixels, 1, (size_t)header.width * header.height, file);
+
+    fclose(file);
+}
+
+unsigned int font_pack_rects(void *rects, unsigned int count, unsigned int width, unsigned int padding, void *sorted)
+{
+    stbrp_rect *input = rects, *output = sorted;
+    unsigned int offsets[256 + 1] = {0}, i, used = 0;
+
+    // Tallest first so each shelf wastes as little height as it can, anything over 255 goes first
+    for (i = 0; i < count; i++)
+        offsets[255 - (input[i].h > 255 ? 255 : input[i].h) + 1]++;
+
+    for (i = 1; i <= 256; i++)
+        offsets[i] += offsets[i - 1];
+
+    for (i = 0; i < count; i++)
+    {
+        stbrp_rect *rect = &output[offsets[255 - (input[i].h > 255 ? 255 : input[i].h)]++];
+        *rect = input[i];
+        rect->id = i;
+    }
+
+    stbtt_pack_context context;
+    stbtt_PackBegin(&context, NULL, width, 0x7FFFFFFF, 0, padding, NULL);
+    stbtt_PackFontRangesPackRects(&context, output, count);
+    stbtt_PackEnd(&context);
+
+    for (i = 0; i < count; i++)
+    {
+        input[output[i].id] = output[i];
+
+        if ((unsigned int)(output[i].y + output[i].h) > used)
+            used = output[i].y + output[i].h;
+    }
+
+    return used + padding;
+}
+
+Font *font_load_dynamic(const char *path, float font_size, GlyphCache *cache)
 {
     unsigned char *bytes = utils_read_file_bytes(path);
 
     if (!bytes)
         return 0;
 
-    // TODO: find automatic way to determine resolution
-    int w_res = 2048;
-    int h_res = 2048;
+    stbtt_fontinfo *info = malloc(sizeof(stbtt_fontinfo));
+
+    if (!stbtt_InitFont(info, bytes, stbtt_GetFontOffsetForIndex(bytes, 0)))
+    {
+        free(info);
+        free(bytes);
+        return 0;
+    }
+
+    Font *font = calloc(1, sizeof(Font));
+    font->info = info;
+    font->data = bytes;
+    font->size = font_size;
+    font->scale = stbtt_ScaleForPixelHeight(info, font_size);
+    font_load_metrics(font, info);
 
-    unsigned char *temp_bitmap = malloc(w_res * h_res);
+    if (!cache)
+    {
+        cache = glyph_cache_create(GLYPH_CACHE_DEFAULT_SIZE, GLYPH_CACHE_DEFAULT_SIZE);
+        font->owns_cache = true;
+    }
+
+    font->cache = cache;
+    font->bitmap = cache->texture;
+
+    return font;
+}
 
-    Font *font = malloc(sizeof(Font));
+Font *font_load_sdf(const char *path, float reference_size, GlyphCache *cache)
+{
+    Font *font = font_load_dynamic(path, reference_size, cache);
 
-    stbtt_BakeFontBitmap(bytes, 0, font_size, temp_bitmap, w_res, h_res, 32, 96, (stbtt_bakedchar *)font->character_data);
-    font->bitmap = texture_load(temp_bitmap, w_res, h_res, 1);
+    if (font)
+        font->sdf = true;
 
-    free(temp_bitmap);
-    free(bytes);
     return font;
 }
 
 void font_unload(Font *font)
 {
-    texture_unload(font->bitmap);
+    if (!font->cache)
+        texture_unload(font->bitmap);
+    else if (font->owns_cache)
+        glyph_cache_destroy(font->cache);
+    else
+        glyph_cache_remove(font->cache, font, -1);
+
+    free(font->info);
+    free(font->data);
+    free(font->kerning);
+    free(font->character_data);
+    free(font->ranges);
     free(font);
 }
 
+void font_load_metrics(Font *font, void *info)
+{
+    stbtt_fontinfo *face = info;
+    int ascent, descent, line_gap, advance, bearing;
+
+    stbtt_GetFontVMetrics(face, &ascent, &descent, &line_gap);
+    font->ascent = ascent * font->scale;
+    font->descent = descent * font->scale;
+    font->line_gap = line_gap * font->scale;
+
+    // Missing characters still advance by the width of the glyph drawn in their place
+    int glyphs[FONT_ADVANCE_TABLE_SIZE];
+    unsigned int i, j;
+    for (i = 0; i < FONT_ADVANCE_TABLE_SIZE; i++)
+    {
+        glyphs[i] = 0;
+        font->advances[i] = 0;
+
+        if (i < 32)
+            continue;
+
+        glyphs[i] = stbtt_FindGlyphIndex(face, i);
+        stbtt_GetGlyphHMetrics(face, glyphs[i], &advance, &bearing);
+        font->advances[i] = advance * font->scale;
+    }
+
+    if (!face->kern && !face->gpos)
+        return;
+
+    FontKerningPair *pairs = NULL;
+    unsigned int num_pairs = 0, max_pairs = 0;
+
+    for (i = 32; i < FONT_ADVANCE_TABLE_SIZE; i++)
+    {
+        for (j = 32; j < FONT_ADVANCE_TABLE_SIZE && glyphs[i]; j++)
+        {
+            int kern = glyphs[j] ? stbtt_GetGlyphKernAdvance(face, glyphs[i], glyphs[j]) : 0;
+
+            if (!kern)
+                continue;
+
+            if (num_pairs == max_pairs)
+            {
+                max_pairs = max_pairs ? max_pairs * 2 : 256;
+                pairs = realloc(pairs, max_pairs * sizeof(FontKerningPair));
+            }
+
+            pairs[num_pairs++] = (FontKerningPair){((i << 8) | j) + 1, kern * font->scale};
+        }
+    }
+
+    if (!num_pairs)
+        return;
+
+    // Open addressing at most half full, a zero key marks an empty slot
+    unsigned int capacity = 16;
+    while (capacity < num_pairs * 2)
+        capacity *= 2;
+
+    font->kerning = calloc(capacity, sizeof(FontKerningPair));
+    font->kerning_mask = capacity - 1;
+
+    for (i = 0; i < num_pairs; i++)
+    {
+        unsigned int slot = font_kerning_slot(pairs[i].key) & font->kerning_mask;
+
+        while (font->kerning[slot].key)
+            slot = (slot + 1) & font->kerning_mask;
+
+        font->kerning[slot] = pairs[i];
+    }
+
+    free(pairs);
+}
+
+float font_get_advance(Font *font, unsigned int codepoint)
+{
+    if (codepoint < FONT_ADVANCE_TABLE_SIZE)
+        return font->advances[codepoint];
+
+    if (!font->info)
+    {
+        Character *character = font_get_character(font, codepoint);
+        return character ? character->xadvance : 0;
+    }
+
+    int advance, bearing;
+    stbtt_GetCodepointHMetrics(font->info, codepoint, &advance, &bearing);
+
+    return advance * font->scale;
+}
+
+Character *font_get_character(Font *font, unsigned int codepoint)
+{
+    unsigned int first = 0, i;
+    for (i = 0; i < font->num_ranges; i++)
+    {
+        FontRange *range = &font->ranges[i];
+
+        // Code points the face doesn't have were never packed and advance by nothing
+        if (codepoint - range->first < range->count)
+        {
+            Character *character = &font->character_data[first + codepoint - range->first];
+            return character->xadvance ? character : NULL;
+        }
+
+        first += range->count;
+    }
+
+    return NULL;
+}
+
+float font_get_kerning(Font *font, unsigned int left, unsigned int right)
+{
+    if (left < 32)
+        return 0;
+
+    if (left < FONT_ADVANCE_TABLE_SIZE && right < FONT_ADVANCE_TABLE_SIZE)
+    {
+        if (!font->kerning)
+            return 0;
+
+        unsigned int key = ((left << 8) | right) + 1;
+        unsigned int slot = font_kerning_slot(key) & font->kerning_mask;
+
+        while (font->kerning[slot].key)
+        {
+            if (font->kerning[slot].key == key)
+                return font->kerning[slot].advance;
+
+            slot = (slot + 1) & font->kerning_mask;
+        }
+
+        return 0;
+    }
+
+    if (!font->info)
+        return 0;
+
+    return stbtt_GetCodepointKernAdvance(font->info, left, right) * font->scale;
+}
+
+unsigned int font_kerning_slot(unsigned int key)
+{
+    unsigned int hash = key * 2654435761u;
+    return hash ^ (hash >> 15);
+}
+
+GlyphCache *glyph_cache_create(unsigned int width, unsigned int height)
+{
+    GlyphCache *cache = calloc(1, sizeof(GlyphCache));
+
+    unsigned char *blank = calloc(width * height, 1);
+    cache->texture = texture_load(blank, width, height, 1);
+    free(blank);
+
+    cache->free_list = -1;
+    cache->num_buckets = 64;
+    cache->buckets = malloc(cache->num_buckets * sizeof(int));
+
+    unsigned int i;
+    for (i = 0; i < cache->num_buckets; i++)
+        cache->buckets[i] = -1;
+
+    return cache;
+}
+
+void glyph_cache_destroy(GlyphCache *cache)
+{
+    texture_unload(cache->texture);
+    free(cache->shelves);
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache->pixels);
+    free(cache);
+}
+
+GlyphCacheStats glyph_cache_get_stats(GlyphCache *cache)
+{
+    return cache->stats;
+}
+
+void glyph_cache_reset_stats(GlyphCache *cache)
+{
+    cache->stats = (GlyphCacheStats){0, 0, 0, 0};
+}
+
+GlyphCacheEntry *glyph_cache_get(GlyphCache *cache, Font *font, unsigned int codepoint)
+{
+    unsigned int bucket = glyph_cache_hash(font, codepoint) & (cache->num_buckets - 1);
+
+    int i;
+    for (i = cache->buckets[bucket]; i >= 0; i = cache->entries[i].next)
+    {
+        GlyphCacheEntry *entry = &cache->entries[i];
+
+        if (entry->font != font || entry->codepoint != codepoint)
+            continue;
+
+        if (entry->shelf >= 0)
+        {
+            cache->shelves[entry->shelf].last_used = ++cache->tick;
+            cache->shelves[entry->shelf].frame = graphics.frame;
+        }
+
+        cache->stats.hits++;
+        return entry;
+    }
+
+    stbtt_fontinfo *info = font->info;
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0, advance, bearing;
+    unsigned char *sdf = NULL;
+
+    stbtt_GetCodepointHMetrics(info, codepoint, &advance, &bearing);
+
+    if (font->sdf)
+    {
+        int sdf_width, sdf_height;
+        sdf = stbtt_GetCodepointSDF(info, font->scale, codepoint, FONT_SDF_PADDING, FONT_SDF_ON_EDGE, (float)FONT_SDF_ON_EDGE / FONT_SDF_PADDING, &sdf_width, &sdf_height, &x0, &y0);
+
+        if (sdf)
+        {
+            x1 = x0 + sdf_width;
+            y1 = y0 + sdf_height;
+        }
+    }
+    else
+    {
+        stbtt_GetCodepointBitmapBox(info, codepoint, font->scale, font->scale, &x0, &y0, &x1, &y1);
+    }
+
+    unsigned int width = x1 - x0, height = y1 - y0, x = 0, y = 0;
+    int shelf = -1;
+
+    // Blank glyphs like spaces only need their metrics
+    if (width && height)
+    {
+        unsigned int stride = width + 2 * GLYPH_CACHE_PADDING, rows = height + 2 * GLYPH_CACHE_PADDING;
+
+        shelf = glyph_cache_alloc(cache, stride, rows, &x, &y);
+
+        if (shelf < 0)
+        {
+            stbtt_FreeSDF(sdf, NULL);
+            cache->stats.dropped++;
+            return NULL;
+        }
+
+        if (stride * rows > cache->max_pixels)
+        {
+            cache->max_pixels = stride * rows;
+            cache->pixels = realloc(cache->pixels, cache->max_pixels);
+        }
+
+        // The padding is uploaded too, it may still hold an evicted glyph
+        memset(cache->pixels, 0, stride * rows);
+        unsigned char *pixels = cache->pixels + GLYPH_CACHE_PADDING * stride + GLYPH_CACHE_PADDING;
+
+        if (sdf)
+        {
+            unsigned int row;
+            for (row = 0; row < height; row++)
+                memcpy(pixels + row * stride, sdf + row * width, width);
+
+            stbtt_FreeSDF(sdf, NULL);
+        }
+        else
+        {
+            stbtt_MakeCodepointBitmap(info, pixels, width, height, stride, font->scale, font->scale, codepoint);
+        }
+
+        glBindTexture(GL_TEXTURE_2D, cache->texture->id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, stride, rows, GL_RED, GL_UNSIGNED_BYTE, cache->pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        x += GLYPH_CACHE_PADDING;
+        y += GLYPH_CACHE_PADDING;
+    }
+
+    int index;
+    if (cache->free_list >= 0)
+    {
+        index = cache->free_list;
+        cache->free_list = cache->entries[index].next;
+    }
+    else
+    {
+        if (cache->num_entries == cache->max_entries)
+        {
+            cache->max_entries = cache->max_entries ? cache->max_entries * 2 : 128;
+            cache->entries = realloc(cache->entries, cache->max_entries * sizeof(GlyphCacheEntry));
+        }
+
+        index = cache->num_entries++;
+    }
+
+    GlyphCacheEntry *entry = &cache->entries[index];
+    entry->font = font;
+    entry->codepoint = codepoint;
+    entry->x = x;
+    entry->y = y;
+    entry->width = width;
+    entry->height = height;
+    entry->xoff = (float)x0;
+    entry->yoff = (float)y0;
+    entry->xadvance = advance * font->scale;
+    entry->shelf = shelf;
+
+    glyph_cache_insert(cache, index);
+    cache->stats.rasterized++;
+
+    return entry;
+}
+
+int glyph_cache_alloc(GlyphCache *cache, unsigned int width, unsigned int height, unsigned int *x, unsigned int *y)
+{
+    unsigned int atlas_width = cache->texture->width, atlas_height = cache->texture->height;
+
+    if (width > atlas_width || height > atlas_height)
+        return -1;
+
+    int best = -1;
+
+    // The shortest shelf with room left
+    unsigned int i;
+    for (i = 0; i < cache->num_shelves; i++)
+    {
+        GlyphShelf *shelf = &cache->shelves[i];
+
+        if (shelf->height >= height && atlas_width - shelf->used >= width && (best < 0 || shelf->height < cache->shelves[best].height))
+            best = i;
+    }
+
+    // Rather open a new shelf than waste more than half of an old one
+    if (best < 0 || cache->shelves[best].height > height * 2)
+    {
+        unsigned int shelf_height = (height + GLYPH_CACHE_SHELF_ROUND - 1) / GLYPH_CACHE_SHELF_ROUND * GLYPH_CACHE_SHELF_ROUND;
+
+        if (cache->top + shelf_height <= atlas_height)
+        {
+            if (cache->num_shelves == cache->max_shelves)
+            {
+                cache->max_shelves = cache->max_shelves ? cache->max_shelves * 2 : 16;
+                cache->shelves = realloc(cache->shelves, cache->max_shelves * sizeof(GlyphShelf));
+            }
+
+            cache->shelves[cache->num_shelves] = (GlyphShelf){cache->top, shelf_height, 0, 0, 0};
+            best = cache->num_shelves++;
+            cache->top += shelf_height;
+        }
+    }
+
+    // Out of room, empty the least recently drawn shelf that's tall enough
+    if (best < 0)
+    {
+        for (i = 0; i < cache->num_shelves; i++)
+        {
+            GlyphShelf *shelf = &cache->shelves[i];
+
+            if (shelf->height < height || shelf->frame == graphics.frame)
+                continue;
+
+            if (best < 0 || shelf->last_used < cache->shelves[best].last_used)
+                best = i;
+        }
+
+        if (best < 0)
+            return -1;
+
+        glyph_cache_remove(cache, NULL, best);
+    }
+
+    GlyphShelf *shelf = &cache->shelves[best];
+
+    *x = shelf->used;
+    *y = shelf->y;
+
+    shelf->used += width;
+    shelf->last_used = ++cache->tick;
+    shelf->frame = graphics.frame;
+
+    return best;
+}
+
+void glyph_cache_remove(GlyphCache *cache, const Font *font, int shelf)
+{
+    unsigned int i;
+    for (i = 0; i < cache->num_buckets; i++)
+    {
+        int *link = &cache->buckets[i];
+
+        while (*link >= 0)
+        {
+            int index = *link;
+            GlyphCacheEntry *entry = &cache->entries[index];
+
+            if (font ? entry->font != font : entry->shelf != shelf)
+            {
+                link = &entry->next;
+                continue;
+            }
+
+            *link = entry->next;
+
+            entry->font = NULL;
+            entry->next = cache->free_list;
+            cache->free_list = index;
+            cache->num_glyphs--;
+
+            if (!font)
+                cache->stats.evicted++;
+        }
+    }
+
+    // An unloaded font's texels stay put until their shelf gets evicted,
+    // and text runs learn that glyphs they hold may have moved
+    if (!font)
+    {
+        cache->shelves[shelf].used = 0;
+        cache->generation++;
+    }
+}
+
+void glyph_cache_insert(GlyphCache *cache, int index)
+{
+    unsigned int i;
+
+    if (cache->num_glyphs >= cache->num_buckets)
+    {
+        cache->num_buckets *= 2;
+        cache->buckets = realloc(cache->buckets, cache->num_buckets * sizeof(int));
+
+        for (i = 0; i < cache->num_buckets; i++)
+            cache->buckets[i] = -1;
+
+        for (i = 0; i < cache->num_entries; i++)
+        {
+            GlyphCacheEntry *entry = &cache->entries[i];
+
+            if (!entry->font || (int)i == index)
+                continue;
+
+            unsigned int bucket = glyph_cache_hash(entry->font, entry->codepoint) & (cache->num_buckets - 1);
+            entry->next = cache->buckets[bucket];
+            cache->buckets[bucket] = i;
+        }
+    }
+
+    GlyphCacheEntry *entry = &cache->entries[index];
+    unsigned int bucket = glyph_cache_hash(entry->font, entry->codepoint) & (cache->num_buckets - 1);
+
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = index;
+    cache->num_glyphs++;
+}
+
+unsigned int glyph_cache_hash(const Font *font, unsigned int codepoint)
+{
+    unsigned int hash = ((unsigned int)((size_t)font >> 4) * 31u + codepoint) * 2654435761u;
+    return hash ^ (hash >> 16);
+}
+
 /*********************************************************
  *                 FRAMEBUFFER FUNCTIONS                 *
  *********************************************************/
@@ -719,9 +4128,10 @@ void font_unload(Font *font)
 Framebuffer *framebuffer_create_depth(int width, int height)
 {
     Framebuffer *result = malloc(sizeof(Framebuffer));
-    result->texture = malloc(sizeof(Texture));
+    result->texture = calloc(1, sizeof(Texture));
     result->texture->width = width;
     result->texture->height = height;
+    result->texture->target = GL_TEXTURE_2D;
 
     glGenFramebuffers(1, &result->id);
 
@@ -9,6 +9,25 @@
 #include <GLFW/glfw3.h>
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <float.h>
+
+/*********************************************************
+ *                     GL EXTENSIONS                     *
+ *********************************************************/
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (APIENTRYP PFNSHLIBBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+typedef GLuint64 (APIENTRYP PFNSHLIBGETTEXTUREHANDLEPROC)(GLuint texture);
+typedef void (APIENTRYP PFNSHLIBMAKETEXTUREHANDLERESIDENTPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNSHLIBMAKETEXTUREHANDLENONRESIDENTPROC)(GLuint64 handle);
 
 /*********************************************************
  *                      ENUMERATIONS                     *
@@ -94,6 +113,23 @@ typedef struct Matrix
 } Matrix;
 
 
+/*
+ * A 2D affine transform, row major like Matrix:
+ * x' = m00 * x + m01 * y + m02 and y' = m10 * x + m11 * y + m12
+ */
+typedef struct Transform2D
+{
+    float m00, m01, m02;
+    float m10, m11, m12;
+} Transform2D;
+
+typedef struct BatchVertex
+{
+    Vec2 position;
+    Vec2 tex_coord;
+    Vec4 color;
+} BatchVertex;
+
 typedef struct Vertex2D
 {
     Vec3 position;
@@ -102,12 +138,77 @@ typedef struct Vertex2D
     float tex_id;
 } QuadVertex;
 
+/*
+ * One sprite of an instanced batch. The vertex shader expands it to a quad
+ * from gl_VertexID: locations 0-5 are center, half_size, rotation, color
+ * (normalized), tex_rect (normalized u0, v0, u1, v1) and tex_id (integer).
+ */
+typedef struct QuadInstance
+{
+    Vec2 center;
+    Vec2 half_size;
+    float rotation;
+    unsigned char color[4];
+    unsigned short tex_rect[4];
+    unsigned int tex_id;
+} QuadInstance;
+
+/*
+ * Lines use locations 0-2: position, color and edge (the distance across
+ * the line from its center, the half width the quad reaches out to and the
+ * distances from either faded end). Coverage is clamp(edge.y - abs(edge.x))
+ * times clamp(min(edge.z, edge.w)), as the fade is one unit wide.
+ */
 typedef struct LineVertex
 {
     Vec3 position;
     Vec4 color;
+    Vec4 edge;
 } LineVertex;
 
+/*
+ * Shapes use locations 0-4: position, color, local (the offset from the
+ * shape's center before any transform), shape (half width, half height,
+ * corner or outer radius, outline thickness with 0 filled) and arc (the
+ * angle the arc is centered on and half its sweep, 0 for boxes).
+ */
+typedef struct ShapeVertex
+{
+    Vec3 position;
+    Vec4 color;
+    Vec2 local;
+    Vec4 shape;
+    Vec2 arc;
+} ShapeVertex;
+
+/*
+ * Vertex layouts used by batches created with BATCH_COMPACT. Quads use
+ * locations 0-4: position, color (normalized), tex_coord (normalized),
+ * tex_id (integer) and depth (normalized to [-1, 1]).
+ */
+typedef struct CompactQuadVertex
+{
+    Vec2 position;
+    unsigned char color[4];
+    unsigned short tex_coord[2];
+    unsigned short tex_id;
+    short depth;
+} CompactQuadVertex;
+
+typedef struct CompactLineVertex
+{
+    Vec2 position;
+    unsigned char color[4];
+    Vec4 edge;
+} CompactLineVertex;
+
+// A line quad before it's transformed and colored, see LineVertex for edges
+typedef struct LineQuad
+{
+    Vec2 points[4];
+    Vec4 edges[4];
+} LineQuad;
+
 typedef struct Vertex3D
 {
     Vec3 position;
@@ -127,6 +228,12 @@ typedef struct Texture
     unsigned int channels;
 
     unsigned int id;
+    unsigned int target;
+
+    struct Texture *array;
+    unsigned int layer;
+    unsigned long long handle;
+    bool opaque;
 } Texture;
 
 typedef struct Mesh
@@ -148,37 +255,520 @@ typedef struct Framebuffer
     Texture *texture;
 } Framebuffer;
 
+// Latin-1 advances and kerning pairs are precomputed for every font
+#define FONT_ADVANCE_TABLE_SIZE 256
+
+typedef struct FontKerningPair
+{
+    unsigned int key;
+    float advance;
+} FontKerningPair;
+
+// Laid out like stbtt_packedchar, xoff2 and yoff2 size the quad when oversampled
 typedef struct Character
 {
     unsigned short x0, y0, x1, y1;
     float xoff, yoff, xadvance;
+    float xoff2, yoff2;
 } Character;
 
+typedef struct FontRange
+{
+    unsigned int first;
+    unsigned int count;
+} FontRange;
+
+typedef struct GlyphCacheEntry
+{
+    const struct Font *font;
+    unsigned int codepoint;
+
+    unsigned short x, y, width, height;
+    float xoff, yoff, xadvance;
+
+    int shelf;
+    int next;
+} GlyphCacheEntry;
+
+typedef struct GlyphShelf
+{
+    unsigned int y, height;
+    unsigned int used;
+    unsigned int last_used;
+    unsigned int frame;
+} GlyphShelf;
+
+typedef struct GlyphCacheStats
+{
+    unsigned int hits;
+    unsigned int rasterized;
+    unsigned int evicted;
+    unsigned int dropped;
+} GlyphCacheStats;
+
+typedef struct GlyphCache
+{
+    Texture *texture;
+
+    GlyphShelf *shelves;
+    unsigned int num_shelves, max_shelves;
+    unsigned int top;
+
+    GlyphCacheEntry *entries;
+    unsigned int num_entries, max_entries;
+    int free_list;
+    int *buckets;
+    unsigned int num_buckets;
+    unsigned int num_glyphs;
+
+    unsigned char *pixels;
+    unsigned int max_pixels;
+
+    unsigned int tick;
+    unsigned int generation;
+    GlyphCacheStats stats;
+} GlyphCache;
+
 typedef struct Font
 {
     Texture *bitmap;
-    Character character_data[96];
+    Character *character_data;
+    FontRange *ranges;
+    unsigned int num_ranges;
+    unsigned int oversample_x, oversample_y;
+
+    GlyphCache *cache;
+    bool owns_cache;
+    void *info;
+    unsigned char *data;
+    float size;
+    float scale;
+    bool sdf;
+
+    float ascent, descent, line_gap;
+    float advances[FONT_ADVANCE_TABLE_SIZE];
+    FontKerningPair *kerning;
+    unsigned int kerning_mask;
 } Font;
 
-typedef struct Batch
+typedef struct TextLine
+{
+    unsigned int start;
+    unsigned int length;
+    float width;
+    bool ellipsis;
+} TextLine;
+
+typedef struct TextRunGlyph
+{
+    Vec2 position;
+    Vec2 size;
+    Vec2 uv[4];
+    int shelf;
+} TextRunGlyph;
+
+#define BATCH_MAX_FRAMES_IN_FLIGHT 8
+
+typedef enum BatchFlags
+{
+    BATCH_STREAMING = 1 << 0,
+    BATCH_INSTANCED = 1 << 1,
+    BATCH_COMPACT = 1 << 2,
+    BATCH_TEXTURE_ARRAYS = 1 << 3,
+    BATCH_BINDLESS = 1 << 4,
+    BATCH_DEFERRED = 1 << 5,
+    BATCH_DEPTH_PASSES = 1 << 6,
+    BATCH_PREMULTIPLIED_ALPHA = 1 << 7,
+} BatchFlags;
+
+typedef enum LineJoin
+{
+    LINE_JOIN_MITER = 0,
+    LINE_JOIN_BEVEL,
+    LINE_JOIN_ROUND,
+} LineJoin;
+
+typedef enum LineCap
+{
+    LINE_CAP_BUTT = 0,
+    LINE_CAP_SQUARE,
+    LINE_CAP_ROUND,
+} LineCap;
+
+typedef enum BlendMode
+{
+    BLEND_ALPHA = 0,
+    BLEND_PREMULTIPLIED,
+    BLEND_ADDITIVE,
+    BLEND_MULTIPLY,
+} BlendMode;
+
+#define BATCH_MAX_TEXTURES 16
+
+// 16-bit indices reach 65536 vertices, so that's as many quads as one draw can hold
+#define BATCH_MAX_DRAW_ELEMENTS 16384
+
+// Capacities grow by doubling, so none of them can start out at 0
+#define BATCH_MIN_ELEMENTS 1
+
+// Sort key layout, most significant first: layer, blend mode, texture, depth
+#define BATCH_KEY_LAYER_SHIFT 56
+#define BATCH_KEY_BLEND_SHIFT 52
+#define BATCH_KEY_TEXTURE_SHIFT 32
+#define BATCH_KEY_TEXTURE_MASK 0xFFFFFu
+
+// Sort key layout with BATCH_DEPTH_PASSES: pass, depth, layer, texture
+#define BATCH_PASS_KEY_TRANSLUCENT_SHIFT 63
+#define BATCH_PASS_KEY_DEPTH_SHIFT 31
+#define BATCH_PASS_KEY_LAYER_SHIFT 23
+#define BATCH_PASS_KEY_BLEND_SHIFT 20
+#define BATCH_MAX_BINDLESS_TEXTURES 65536
+#define TEXTURE_ARRAY_MAX_LAYERS 256
+
+// Width of the faded line edge and how far a miter may reach (in half widths)
+#define BATCH_LINE_FEATHER 1.0f
+#define BATCH_LINE_MITER_LIMIT 4.0f
+
+// How far shape quads reach past the shape so its edge can fade out
+#define BATCH_SHAPE_FEATHER 1.0f
+
+// Clip rect (left, top, right, bottom) of a batch with nothing pushed
+#define BATCH_NO_CLIP ((Vec4){-FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX})
+
+// Opaque draw range of a batch holding no opaque pass
+#define BATCH_NO_PASS (~0u)
+
+// Sprites resolved per pass of batch_add_sprites_soa
+#define BATCH_SOA_CHUNK 256
+
+// Deepest level a scene quadtree can have, 4^10 cells at the bottom
+#define SCENE_MAX_DEPTH 10
+
+// Furthest a flattened curve may stray from the real one, in pixels
+#define PATH_TOLERANCE 0.25f
+#define PATH_MAX_SEGMENTS 256
+
+// Blank texels around each baked or cached glyph so filtering doesn't pick up its neighbours
+#define FONT_ATLAS_PADDING 1
+#define GLYPH_CACHE_PADDING 1
+// Shelf heights are rounded up to this so similar glyphs share shelves
+#define GLYPH_CACHE_SHELF_ROUND 4
+#define GLYPH_CACHE_DEFAULT_SIZE 512
+
+// Distance field texels kept around SDF glyphs and the value their edge lands on
+#define FONT_SDF_PADDING 8
+#define FONT_SDF_ON_EDGE 128
+
+// "SHFC" read as a little endian int, bump the version whenever the layout below changes
+#define FONT_CACHE_MAGIC 0x43464853
+#define FONT_CACHE_VERSION 1
+
+// Everything a cached atlas was baked from
+typedef struct FontCacheKey
+{
+    unsigned long long hash;
+    float size;
+    unsigned int oversample_x, oversample_y;
+    unsigned int num_ranges;
+} FontCacheKey;
+
+// Followed by the ranges, characters, kerning slots and atlas texels
+typedef struct FontCacheHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    FontCacheKey key;
+
+    unsigned int width, height;
+    unsigned int num_kerning;
+    float scale;
+    float ascent, descent, line_gap;
+    float advances[FONT_ADVANCE_TABLE_SIZE];
+} FontCacheHeader;
+
+// Frames a cached text run may go undrawn before it's freed
+#define TEXT_RUN_CACHE_MAX_AGE 60
+
+typedef struct BatchTextureEntry
+{
+    unsigned int key;
+    unsigned int slot;
+    unsigned int generation;
+} BatchTextureEntry;
+
+typedef struct BatchOptions
 {
     unsigned int max_elements;
+    unsigned int flags;
+    unsigned int frames_in_flight;
+} BatchOptions;
+
+typedef struct BatchStats
+{
+    unsigned int fence_waits;
+    double fence_wait_time;
+
+    unsigned int draw_calls;
+    unsigned int splits;
+    unsigned int dropped;
+    unsigned int clipped;
+} BatchStats;
+
+typedef struct BatchDraw
+{
+    unsigned int offset;
+    unsigned int count;
+    unsigned int texture_base;
+    Vec4 clip;
+    BlendMode blend;
+} BatchDraw;
+
+typedef struct BatchCommand
+{
+    Transform2D transform;
+    Vec2 uv[4];
+    Vec4 color;
+    float depth;
+    Vec4 clip;
+    BlendMode blend;
+    Texture *texture;
+} BatchCommand;
+
+typedef struct BatchSortEntry
+{
+    unsigned long long key;
+    unsigned int index;
+} BatchSortEntry;
+
+typedef struct BatchRecorder
+{
+    struct Batch *batch;
+
+    void *quad_data;
     unsigned int num_quads;
-    unsigned int num_lines;
+    unsigned int quad_capacity;
+    unsigned int *texture_indices;
+
+    Texture **textures;
+    unsigned int num_textures, max_textures;
+    Texture *last_texture;
+    unsigned int last_index;
+
+    float depth;
+} BatchRecorder;
+
+typedef struct StreamBuffer
+{
+    unsigned int buffer;
+    unsigned int region_size;
+    unsigned int num_regions;
+    unsigned int region;
+    unsigned int first;
+    bool persistent;
+
+    unsigned char *mapped;
+    void *fences[BATCH_MAX_FRAMES_IN_FLIGHT];
+} StreamBuffer;
+
+/*
+ * Everything one kind of element (quads, lines or shapes) keeps apart: the
+ * client side vertices, counted in elements of four vertices, the draws
+ * closed so far and the GL objects they're drawn from.
+ */
+typedef struct BatchStream
+{
+    void *data;
+    unsigned int size;
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int buffer_capacity;
+    unsigned int offset;
+
+    BatchDraw *draws;
+    unsigned int num_draws, max_draws;
+    unsigned int draw_start;
 
-    QuadVertex *quad_vertices;
-    unsigned int *quad_indices;
+    unsigned int vao, vbo;
+    StreamBuffer stream;
+} BatchStream;
 
-    LineVertex *line_vertices;
+typedef struct Batch
+{
+    unsigned int max_elements;
+    unsigned int max_draw_elements;
+    unsigned int flags;
+
+    BatchStream quads, lines, shapes;
 
     Texture **textures;
     unsigned int num_textures;
-
-    unsigned int quad_vao, line_vao;
-    unsigned int quad_vbo, line_vbo;
-    unsigned int quad_ebo;
+    unsigned int max_textures;
+    unsigned int texture_base;
+    unsigned int texture_capacity;
+    Texture *white;
+    unsigned int white_id;
+
+    BatchTextureEntry *texture_map;
+    unsigned int texture_map_size;
+    unsigned int texture_generation;
+    Texture *last_texture;
+    unsigned int last_slot;
+
+    unsigned long long *handles;
+    unsigned int handle_buffer, handle_texture;
+
+    unsigned int layer;
+    float depth;
+    BlendMode blend;
+
+    LineJoin line_join;
+    LineCap line_cap;
+
+    Transform2D transform;
+    Transform2D *transform_stack;
+    unsigned int num_transforms, max_transforms;
+    bool transformed;
+
+    Vec4 clip;
+    Vec4 *clip_stack;
+    unsigned int num_clips, max_clips;
+
+    unsigned int *polygon_indices;
+    unsigned int max_polygon_indices;
+    TextRunGlyph *text_glyphs;
+    unsigned int max_text_glyphs;
+    TextLine *text_lines;
+    unsigned int max_text_lines;
+    LineQuad *line_quads;
+    unsigned int max_line_quads;
+
+    BatchCommand *commands;
+    BatchSortEntry *sort_entries, *sort_scratch;
+    unsigned int num_commands, max_commands;
+    unsigned int opaque_start, opaque_end;
+
+    BatchRecorder *recorders;
+    unsigned int num_recorders, max_recorders;
+    bool recording;
+
+    BatchStats stats;
+    bool frozen;
+    bool cached_glyphs;
+    float *frozen_depths;
 } Batch;
 
+typedef struct SceneSprite
+{
+    Vec2 position;
+    Vec2 size;
+    Vec4 uv_rect;
+    Vec4 color;
+    Texture *texture;
+
+    int node;
+    int prev, next;
+} SceneSprite;
+
+typedef struct SceneStats
+{
+    unsigned int drawn;
+    unsigned int culled;
+    unsigned int nodes_visited;
+} SceneStats;
+
+typedef struct Scene
+{
+    Vec2 min, max;
+    unsigned int depth;
+
+    int *heads;
+    unsigned int *counts;
+    unsigned int num_nodes;
+    int outside;
+
+    SceneSprite *sprites;
+    unsigned int num_sprites, max_sprites;
+    int free_list;
+
+    SceneStats stats;
+} Scene;
+
+typedef enum PathCommand
+{
+    PATH_MOVE_TO = 0,
+    PATH_LINE_TO,
+    PATH_QUAD_TO,
+    PATH_CUBIC_TO,
+    PATH_CLOSE,
+} PathCommand;
+
+typedef struct PathContour
+{
+    unsigned int first;
+    unsigned int count;
+    bool closed;
+} PathContour;
+
+typedef struct Path
+{
+    unsigned char *commands;
+    unsigned int num_commands, max_commands;
+    Vec2 *points;
+    unsigned int num_points, max_points;
+
+    Vec2 *flat;
+    unsigned int num_flat, max_flat;
+    PathContour *contours;
+    unsigned int num_contours, max_contours;
+    unsigned int *fill_quads;
+    unsigned int num_fill_quads, max_fill_quads;
+    LineQuad *stroke_quads;
+    unsigned int num_stroke_quads, max_stroke_quads;
+    float stroke_width;
+    LineJoin stroke_join;
+    LineCap stroke_cap;
+    unsigned int *scratch;
+    unsigned int max_scratch;
+
+    int bucket;
+    bool dirty;
+    bool filled;
+    bool stroked;
+} Path;
+
+typedef struct TextRun
+{
+    Font *font;
+    char *text;
+    Vec2 position;
+    float size;
+    Vec4 color;
+
+    TextRunGlyph *glyphs;
+    unsigned int num_glyphs, max_glyphs;
+    int *shelves;
+    unsigned int num_shelves, max_shelves;
+    unsigned int generation;
+
+    void *vertices;
+    unsigned int vertex_format;
+    float vertex_depth;
+    int vertex_slot;
+    bool has_vertices;
+
+    unsigned int hash;
+    unsigned int last_frame;
+    struct TextRun *next;
+} TextRun;
+
+typedef struct TextRunCache
+{
+    TextRun **buckets;
+    unsigned int num_buckets;
+    unsigned int num_runs;
+    unsigned int frame;
+} TextRunCache;
+
 typedef struct Window
 {
     GLFWwindow *handle;
@@ -196,6 +786,34 @@ typedef struct Input
     bool keys[KEY_COUNT];
 } Input;
 
+typedef struct TexturePool
+{
+    Texture *array;
+    unsigned int num_layers;
+    unsigned char used[TEXTURE_ARRAY_MAX_LAYERS];
+} TexturePool;
+
+typedef struct Graphics
+{
+    int max_texture_units;
+
+    PFNSHLIBBUFFERSTORAGEPROC buffer_storage;
+    PFNSHLIBGETTEXTUREHANDLEPROC get_texture_handle;
+    PFNSHLIBMAKETEXTUREHANDLERESIDENTPROC make_texture_handle_resident;
+    PFNSHLIBMAKETEXTUREHANDLENONRESIDENTPROC make_texture_handle_non_resident;
+
+    TexturePool *texture_pools;
+    unsigned int num_texture_pools;
+
+    unsigned int quad_ebo;
+    unsigned int quad_ebo_capacity;
+
+    unsigned int frame;
+} Graphics;
+
+// Defined in shlib_core.c
+extern Graphics graphics;
+
 
 /*********************************************************
  *                    WINDOW FUNCTIONS                   *
@@ -219,6 +837,12 @@ void window_resize_callback(GLFWwindow *handle, int width, int height);
 
 char *utils_read_file(const char *path);
 unsigned char *utils_read_file_bytes(const char *path);
+unsigned char *utils_read_file_sized(const char *path, size_t *length);
+unsigned int utils_utf8_decode(const char **text);
+
+unsigned char pack_unorm8(float value);
+unsigned short pack_unorm16(float value);
+short pack_snorm16(float value);
 
 /*********************************************************
  *                     INPUT FUNCTIONS                   *
@@ -239,7 +863,13 @@ void input_key_callback(GLFWwindow *handle, int key, int scancode, int action, i
 
 void graphics_clear_screen(Vec4 color);
 void graphics_draw_batch_quads(Batch *batch);
+void graphics_draw_batch_lines(Batch *batch);
+void graphics_draw_batch_shapes(Batch *batch);
+void graphics_draw_batch_stream(Batch *batch, BatchStream *stream);
+void graphics_apply_clip(Vec4 clip, Vec4 *bound, int viewport[4]);
+void graphics_apply_blend(BlendMode mode, BlendMode *bound);
 void graphics_draw_mesh(Mesh *mesh);
+void graphics_reserve_quad_indices(unsigned int count);
 
 /*********************************************************
  *                    SHADER FUNCTIONS                   *
@@ -264,26 +894,228 @@ void shader_upload_matrix(Shader *shader, const char *name, Matrix value);
 Texture *texture_load_from_file(const char *path);
 Texture *texture_load(void *data, int width, int height, int channels);
 void texture_unload(Texture *texture);
+void texture_set_opaque(Texture *texture, bool opaque);
+bool texture_data_opaque(const unsigned char *data, unsigned int num_pixels, int channels);
 void texture_use(Texture *texture, int slot);
 
+bool texture_array_place(Texture *texture);
+void texture_array_release(Texture *texture);
+unsigned long long texture_get_handle(Texture *texture);
+
 /*********************************************************
  *                     BATCH FUNCTIONS                   *
  *********************************************************/
 
 Batch *batch_create(unsigned int max_elements);
+Batch *batch_create_with_options(BatchOptions options);
 void batch_destroy(Batch *batch);
+void batch_stream_create(Batch *batch, BatchStream *stream, unsigned int max_elements, unsigned int frames_in_flight);
+void batch_stream_destroy(Batch *batch, BatchStream *stream);
 void batch_add_sprite(Batch *batch, Vec2 position, Vec2 size, Texture *texture);
 void batch_add_sprite_uv(Batch *batch, Vec2 position, Vec2 size, Vec2 uv[4], Texture *texture);
 void batch_add_text(Batch *batch, Vec2 position, Font *font, const char *text);
+void batch_add_text_scaled(Batch *batch, Vec2 position, Font *font, const char *text, float size, Vec4 color);
 void batch_add_quad(Batch *batch, Vec2 position, Vec2 size, Vec4 color);
+void batch_add_sprite_rotated(Batch *batch, Vec2 position, Vec2 size, float rotation, Vec2 pivot, Texture *texture);
+void batch_add_quad_rotated(Batch *batch, Vec2 position, Vec2 size, float rotation, Vec2 pivot, Vec4 color);
+void batch_add_sprite_transformed(Batch *batch, Transform2D transform, Vec2 uv[4], Vec4 color, Texture *texture);
+void batch_push_transform(Batch *batch, Transform2D transform);
+void batch_pop_transform(Batch *batch);
+void batch_push_clip(Batch *batch, Vec2 position, Vec2 size);
+void batch_pop_clip(Batch *batch);
+void batch_add_sprites_soa(Batch *batch, unsigned int count, const Vec2 *positions, const Vec2 *sizes, const Vec4 *colors, const Vec4 *uv_rects, Texture **textures);
+void batch_add_triangles(Batch *batch, const BatchVertex *vertices, unsigned int num_vertices, const unsigned int *indices, unsigned int num_indices, Texture *texture);
+void batch_add_convex_polygon(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color);
+void batch_add_polygon(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color);
 void batch_add_line(Batch *batch, Vec2 start, Vec2 end, Vec4 color, float width);
+void batch_add_polyline(Batch *batch, const Vec2 *points, unsigned int count, Vec4 color, float width, bool closed);
+void batch_set_line_style(Batch *batch, LineJoin join, LineCap cap);
+void batch_add_circle(Batch *batch, Vec2 center, float radius, Vec4 color);
+void batch_add_rounded_rect(Batch *batch, Vec2 position, Vec2 size, float radius, Vec4 color);
+void batch_add_ring(Batch *batch, Vec2 center, float radius, float thickness, Vec4 color);
+void batch_add_arc(Batch *batch, Vec2 center, float radius, float thickness, float start_angle, float end_angle, Vec4 color);
+bool batch_freeze(Batch *batch);
+void batch_stream_freeze(BatchStream *stream);
+bool batch_update_quad(Batch *batch, unsigned int index, Vec2 position, Vec2 size, Vec2 uv[4], Vec4 color, Texture *texture);
+void batch_set_layer(Batch *batch, unsigned int layer);
+void batch_begin_parallel(Batch *batch, unsigned int num_recorders);
+BatchRecorder *batch_get_recorder(Batch *batch, unsigned int index);
+void batch_end_parallel(Batch *batch);
+void batch_recorder_add_sprite(BatchRecorder *recorder, Vec2 position, Vec2 size, Texture *texture);
+void batch_recorder_add_sprite_uv(BatchRecorder *recorder, Vec2 position, Vec2 size, Vec2 uv[4], Texture *texture);
+void batch_recorder_add_quad(BatchRecorder *recorder, Vec2 position, Vec2 size, Vec4 color);
+void batch_recorder_add_sprite_transformed(BatchRecorder *recorder, Transform2D transform, Vec2 uv[4], Vec4 color, Texture *texture);
+void batch_recorder_set_depth(BatchRecorder *recorder, float depth);
+void batch_set_depth(Batch *batch, float depth);
+void batch_set_blend_mode(Batch *batch, BlendMode mode);
+BatchStats batch_get_stats(Batch *batch);
+void batch_reset_stats(Batch *batch);
+
+int batch_texture_slot(Batch *batch, Texture *texture);
+int batch_texture_find(Batch *batch, unsigned int key);
+void batch_texture_insert(Batch *batch, unsigned int key, unsigned int slot);
+void batch_grow_textures(Batch *batch);
+void batch_reset_textures(Batch *batch);
+void batch_bind_textures(Batch *batch, unsigned int first, unsigned int end);
+bool batch_reserve(Batch *batch, BatchStream *stream, unsigned int count);
+void batch_set_clip(Batch *batch, Vec4 clip);
+BlendMode batch_quad_blend(Batch *batch);
+Vec4 batch_blend_color(Batch *batch, Vec4 color);
+bool batch_clip_rejects(Batch *batch, const Vec2 *points, unsigned int count);
+bool batch_clip_rejects_transform(Batch *batch, const Transform2D *transform);
+unsigned int batch_draw_room(Batch *batch);
+void batch_close_draw(Batch *batch, BatchStream *stream);
+void batch_upload(Batch *batch, BatchStream *stream);
+void batch_rewind(Batch *batch, BatchStream *stream);
+void batch_emit_quad(Batch *batch, Vec2 position, Vec2 size, const Vec2 uv[4], Vec4 color, Texture *texture);
+void batch_emit_transformed(Batch *batch, const Transform2D *transform, const Vec2 uv[4], Vec4 color, Texture *texture);
+void batch_record_quad(Batch *batch, const Transform2D *transform, const Vec2 uv[4], Vec4 color, Texture *texture);
+void batch_add_transformed(Batch *batch, Transform2D transform, const Vec2 uv[4], Vec4 color, Texture *texture);
+Transform2D batch_rotated_transform(Vec2 position, Vec2 size, float rotation, Vec2 pivot);
+unsigned long long batch_sort_key(Batch *batch, Texture *texture, float depth);
+unsigned long long batch_pass_sort_key(Batch *batch, Texture *texture, float depth, Vec4 color);
+void batch_sort_commands(Batch *batch);
+void batch_flush_commands(Batch *batch);
+void batch_push_quad(Batch *batch, Vec2 position, Vec2 size, const Vec2 uv[4], Vec4 color, unsigned int tex_id);
+void batch_push_quad_transformed(Batch *batch, const Transform2D *transform, const Vec2 uv[4], Vec4 color, unsigned int tex_id);
+void batch_write_quad(void *out, unsigned int flags, float depth, Vec2 position, Vec2 size, const Vec2 uv[4], Vec4 color, unsigned int tex_id);
+void batch_write_quad_transformed(void *out, unsigned int flags, float depth, const Transform2D *transform, const Vec2 uv[4], Vec4 color, unsigned int tex_id);
+void batch_write_tex_id(void *out, unsigned int flags, unsigned int tex_id);
+void batch_write_vertices(void *out, unsigned int flags, float depth, const Vec2 positions[4], const BatchVertex corners[4], unsigned int tex_id);
+void batch_emit_vertices(Batch *batch, const BatchVertex corners[4], Texture *texture);
+bool batch_pair_triangles(const unsigned int first[3], const unsigned int second[3], unsigned int quad[4]);
+bool batch_polygon_ear(const Vec2 *points, const unsigned int *remaining, unsigned int count, unsigned int ear, float winding);
+unsigned int batch_triangulate(const Vec2 *points, unsigned int count, unsigned int *remaining, unsigned int *triangles);
+unsigned int batch_pack_triangles(const unsigned int *triangles, unsigned int count, unsigned int *quads);
+void *batch_recorder_next(BatchRecorder *recorder, Texture *texture);
+void batch_merge_recorder(Batch *batch, BatchRecorder *recorder);
+void batch_copy_quads(Batch *batch, const void *quads, unsigned int count);
+void batch_write_sprites(Batch *batch, unsigned int count, const Vec2 *positions, const Vec2 *sizes, const Vec4 *colors, const Vec4 *uv_rects, const unsigned int *tex_ids);
+void batch_rect_uv(Vec4 rect, Vec2 uv[4]);
+void batch_push_line_quad(Batch *batch, const LineQuad *quad, Vec4 color);
+unsigned int batch_expand_polyline(const Vec2 *points, unsigned int count, float width, bool closed, LineJoin join, LineCap cap, LineQuad **quads, unsigned int *max_quads, unsigned int num_quads);
+unsigned int batch_expand_line_segment(Vec2 start, Vec2 end, const Vec2 offsets[4], float start_cap, float end_cap, float outer, LineQuad **quads, unsigned int *max_quads, unsigned int num_quads);
+unsigned int batch_expand_line_fan(Vec2 center, const Vec2 *corner, Vec2 from, float sweep, unsigned int steps, float outer, LineQuad **quads, unsigned int *max_quads, unsigned int num_quads);
+void batch_grow_line_quads(LineQuad **quads, unsigned int *max_quads, unsigned int count);
+Vec2 batch_line_direction(const Vec2 *points, unsigned int count, unsigned int segment, bool closed);
+bool batch_line_miter(Vec2 in, Vec2 out, Vec2 *offset);
+void batch_push_shape(Batch *batch, Vec2 center, Vec2 half_size, float radius, float thickness, float arc_angle, float arc_half_sweep, Vec4 color);
+void batch_bind_instances(Batch *batch, unsigned int offset);
+
+void stream_buffer_create(StreamBuffer *stream, unsigned int region_size, unsigned int num_regions);
+void stream_buffer_destroy(StreamBuffer *stream);
+void *stream_buffer_map(StreamBuffer *stream, BatchStats *stats);
+void *stream_buffer_next(StreamBuffer *stream, unsigned int size, BatchStats *stats);
+unsigned int stream_buffer_unmap(StreamBuffer *stream, unsigned int size);
+void stream_buffer_fence(StreamBuffer *stream);
+
+/*********************************************************
+ *                     SCENE FUNCTIONS                   *
+ *********************************************************/
+
+Scene *scene_create(Vec2 min, Vec2 max, unsigned int depth);
+void scene_destroy(Scene *scene);
+unsigned int scene_add_sprite(Scene *scene, Vec2 position, Vec2 size, Vec4 color, Texture *texture);
+void scene_set_sprite_uv(Scene *scene, unsigned int id, Vec4 uv_rect);
+void scene_update_sprite(Scene *scene, unsigned int id, Vec2 position, Vec2 size);
+void scene_remove_sprite(Scene *scene, unsigned int id);
+void scene_draw(Scene *scene, Batch *batch, Matrix projection);
+SceneStats scene_get_stats(Scene *scene);
+
+int scene_node_for(Scene *scene, Vec2 position, Vec2 size);
+void scene_link(Scene *scene, unsigned int id, int node);
+void scene_unlink(Scene *scene, unsigned int id);
+void scene_query(Scene *scene, Batch *batch, unsigned int level, unsigned int x, unsigned int y, Vec4 view);
+void scene_emit_list(Scene *scene, Batch *batch, int head, const Vec4 *view);
+void scene_emit_all(Scene *scene, Batch *batch, unsigned int level, unsigned int x, unsigned int y);
+void scene_emit_sprite(Scene *scene, Batch *batch, SceneSprite *sprite);
+
+/*********************************************************
+ *                     PATH FUNCTIONS                    *
+ *********************************************************/
+
+Path *path_create(void);
+void path_destroy(Path *path);
+void path_clear(Path *path);
+void path_move_to(Path *path, Vec2 point);
+void path_line_to(Path *path, Vec2 point);
+void path_quad_to(Path *path, Vec2 control, Vec2 point);
+void path_cubic_to(Path *path, Vec2 control1, Vec2 control2, Vec2 point);
+void path_close(Path *path);
+void batch_fill_path(Batch *batch, Path *path, Vec4 color);
+void batch_stroke_path(Batch *batch, Path *path, Vec4 color, float width);
+
+void path_push(Path *path, PathCommand command, const Vec2 *points, unsigned int count);
+int path_scale_bucket(Batch *batch);
+void path_tessellate(Path *path, int bucket);
+void path_fill(Path *path);
+void path_stroke(Path *path, float width, LineJoin join, LineCap cap);
+void path_flat_point(Path *path, Vec2 point);
+unsigned int path_curve_segments(float deviation, float tolerance);
+
+/*********************************************************
+ *                     TEXT FUNCTIONS                    *
+ *********************************************************/
+
+TextRun *text_run_create(Font *font, const char *text, Vec2 position, float size, Vec4 color);
+void text_run_destroy(TextRun *run);
+void batch_add_text_run(Batch *batch, TextRun *run);
+
+TextRunCache *text_run_cache_create(void);
+void text_run_cache_destroy(TextRunCache *cache);
+void text_run_cache_clear(TextRunCache *cache);
+TextRun *text_run_cache_get(TextRunCache *cache, Font *font, const char *text, Vec2 position, float size, Vec4 color);
+void batch_add_text_cached(Batch *batch, TextRunCache *cache, Vec2 position, Font *font, const char *text, float size, Vec4 color);
+
+Vec2 text_measure(Font *font, const char *text, float size);
+float font_get_line_height(Font *font, float size);
+unsigned int text_wrap(Font *font, const char *text, float size, float max_width, unsigned int line_limit, TextLine **lines, unsigned int *max_lines);
+void batch_add_text_wrapped(Batch *batch, Vec2 position, Font *font, const char *text, float size, Vec4 color, float max_width, unsigned int line_limit);
+
+unsigned int text_layout(Font *font, const char *text, const char *end, Vec2 position, float size, TextRunGlyph **glyphs, unsigned int *max_glyphs);
+void text_run_layout(TextRun *run);
+void batch_emit_glyph(Batch *batch, const TextRunGlyph *glyph, Vec4 color, Texture *texture);
+unsigned int text_run_hash(Font *font, const char *text, Vec2 position, float size, Vec4 color);
+void text_run_cache_sweep(TextRunCache *cache);
+float text_width(Font *font, const char *text, const char *end, float scale);
+const char *text_ellipsis(Font *font);
+unsigned int text_wrap_push(TextLine **lines, unsigned int *max_lines, unsigned int count, const char *text, const char *start, const char *end, float width, bool ellipsis);
+bool text_has_content(const char *text);
+unsigned int text_wrap_truncate(Font *font, const char *text, const char *line, float scale, float max_width, TextLine **lines, unsigned int *max_lines, unsigned int count);
+void batch_add_text_span(Batch *batch, Vec2 position, Font *font, const char *text, const char *end, float size, Vec4 color);
 
 /*********************************************************
  *                     FONT FUNCTIONS                    *
  *********************************************************/
 
 Font *font_load_from_file(const char *path, float font_size);
+Font *font_load_packed(const char *path, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y);
+Font *font_load_cached(const char *path, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y, const char *cache_path);
+Font *font_bake(const unsigned char *bytes, float font_size, const FontRange *ranges, unsigned int num_ranges, unsigned int oversample_x, unsigned int oversample_y, unsigned char **atlas);
+unsigned int font_clamp_oversample(unsigned int oversample);
+unsigned long long font_cache_hash(const unsigned char *bytes, size_t length);
+Font *font_cache_read(const char *cache_path, const FontCacheKey *key, const FontRange *ranges);
+void font_cache_write(const char *cache_path, const FontCacheKey *key, Font *font, const unsigned char *pixels);
+Font *font_load_dynamic(const char *path, float font_size, GlyphCache *cache);
+Font *font_load_sdf(const char *path, float reference_size, GlyphCache *cache);
 void font_unload(Font *font);
+void font_load_metrics(Font *font, void *info);
+unsigned int font_pack_rects(void *rects, unsigned int count, unsigned int width, unsigned int padding, void *sorted);
+Character *font_get_character(Font *font, unsigned int codepoint);
+float font_get_advance(Font *font, unsigned int codepoint);
+float font_get_kerning(Font *font, unsigned int left, unsigned int right);
+unsigned int font_kerning_slot(unsigned int key);
+
+GlyphCache *glyph_cache_create(unsigned int width, unsigned int height);
+void glyph_cache_destroy(GlyphCache *cache);
+GlyphCacheStats glyph_cache_get_stats(GlyphCache *cache);
+void glyph_cache_reset_stats(GlyphCache *cache);
+
+GlyphCacheEntry *glyph_cache_get(GlyphCache *cache, Font *font, unsigned int codepoint);
+int glyph_cache_alloc(GlyphCache *cache, unsigned int width, unsigned int height, unsigned int *x, unsigned int *y);
+void glyph_cache_remove(GlyphCache *cache, const Font *font, int shelf);
+void glyph_cache_insert(GlyphCache *cache, int index);
+unsigned int glyph_cache_hash(const Font *font, unsigned int codepoint);
 
 /*********************************************************
  *                 FRAMEBUFFER FUNCTIONS                 *
@@ -318,6 +1150,15 @@ void vec3_print(Vec3 vector);
  *            VECTOR TRANSFORMATION FUNCTIONS            *
  *********************************************************/
 
+Vec2 vec2_add(Vec2 left, Vec2 right);
+Vec2 vec2_sub(Vec2 left, Vec2 right);
+float vec2_dot(Vec2 left, Vec2 right);
+float vec2_cross(Vec2 left, Vec2 right);
+Vec2 vec2_normalize(Vec2 vector);
+Vec2 vec2_scale(Vec2 vector, float scalar);
+Vec2 vec2_rotate(Vec2 vector, float radians);
+float vec2_magnitude(Vec2 vector);
+
 Vec3 vec3_add(Vec3 left, Vec3 right);
 Vec3 vec3_sub(Vec3 left, Vec3 right);
 float vec3_dot(Vec3 left, Vec3 right);
@@ -340,6 +1181,16 @@ Matrix matrix_scale(Matrix matrix, Vec3 scalar);
 Matrix matrix_rotate(Matrix matrix, Quaternion quaternion);
 Matrix matrix_translate(Matrix matrix, Vec3 translation);
 
+/*********************************************************
+ *                 2D TRANSFORM FUNCTIONS                *
+ *********************************************************/
+
+Transform2D transform2d_identity(void);
+Transform2D transform2d_create(Vec2 translation, float rotation, Vec2 scale);
+Transform2D transform2d_mul(Transform2D left, Transform2D right);
+Vec2 transform2d_apply(Transform2D transform, Vec2 point);
+bool transform2d_is_identity(Transform2D transform);
+
 /*********************************************************
  *           MATRIX PROJECTION & VIEW FUNCTIONS          *
  *********************************************************/
@@ -183,6 +183,66 @@ void vec3_print(Vec3 vector)
  *            VECTOR TRANSFORMATION FUNCTIONS            *
  *********************************************************/
 
+Vec2 vec2_add(Vec2 left, Vec2 right)
+{
+    left.x += right.x;
+    left.y += right.y;
+
+    return left;
+}
+
+Vec2 vec2_sub(Vec2 left, Vec2 right)
+{
+    left.x -= right.x;
+    left.y -= right.y;
+
+    return left;
+}
+
+float vec2_dot(Vec2 left, Vec2 right)
+{
+    return left.x * right.x + left.y * right.y;
+}
+
+float vec2_cross(Vec2 left, Vec2 right)
+{
+    return left.x * right.y - left.y * right.x;
+}
+
+Vec2 vec2_normalize(Vec2 vector)
+{
+    float magnitude = sqrtf(vector.x * vector.x + vector.y * vector.y);
+
+    if (magnitude == 0)
+        return (Vec2){ 0, 0 };
+
+    vector.x /= magnitude;
+    vector.y /= magnitude;
+
+    return vector;
+}
+
+Vec2 vec2_scale(Vec2 vector, float scalar)
+{
+    vector.x *= scalar;
+    vector.y *= scalar;
+
+    return vector;
+}
+
+Vec2 vec2_rotate(Vec2 vector, float radians)
+{
+    float c = cosf(radians);
+    float s = sinf(radians);
+
+    return (Vec2){ vector.x * c - vector.y * s, vector.x * s + vector.y * c };
+}
+
+float vec2_magnitude(Vec2 vector)
+{
+    return sqrtf(vector.x * vector.x + vector.y * vector.y);
+}
+
 Vec3 vec3_add(Vec3 left, Vec3 right)
 {
     left.x += right.x;
@@ -351,3 +411,64 @@ Matrix matrix_look_at(Vec3 eye, Vec3 target, Vec3 up)
 
     return result;
 }
+
+/*********************************************************
+ *                 2D TRANSFORM FUNCTIONS                *
+ *********************************************************/
+
+Transform2D transform2d_identity(void)
+{
+    Transform2D result = { 0 };
+    result.m00 = 1;
+    result.m11 = 1;
+    return result;
+}
+
+Transform2D transform2d_create(Vec2 translation, float rotation, Vec2 scale)
+{
+    float c = cosf(rotation);
+    float s = sinf(rotation);
+
+    Transform2D result;
+
+    result.m00 = c * scale.x;
+    result.m01 = -s * scale.y;
+    result.m02 = translation.x;
+
+    result.m10 = s * scale.x;
+    result.m11 = c * scale.y;
+    result.m12 = translation.y;
+
+    return result;
+}
+
+Transform2D transform2d_mul(Transform2D left, Transform2D right)
+{
+    Transform2D result;
+
+    result.m00 = left.m00 * right.m00 + left.m01 * right.m10;
+    result.m01 = left.m00 * right.m01 + left.m01 * right.m11;
+    result.m02 = left.m00 * right.m02 + left.m01 * right.m12 + left.m02;
+
+    result.m10 = left.m10 * right.m00 + left.m11 * right.m10;
+    result.m11 = left.m10 * right.m01 + left.m11 * right.m11;
+    result.m12 = left.m10 * right.m02 + left.m11 * right.m12 + left.m12;
+
+    return result;
+}
+
+Vec2 transform2d_apply(Transform2D transform, Vec2 point)
+{
+    Vec2 result;
+
+    result.x = transform.m00 * point.x + transform.m01 * point.y + transform.m02;
+    result.y = transform.m10 * point.x + transform.m11 * point.y + transform.m12;
+
+    return result;
+}
+
+bool transform2d_is_identity(Transform2D transform)
+{
+    return transform.m00 == 1 && transform.m01 == 0 && transform.m02 == 0 &&
+           transform.m10 == 0 && transform.m11 == 1 && transform.m12 == 0;
+}
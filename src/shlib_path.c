@@ -0,0 +1,347 @@
+#include "shlib_internal.h"
+#include <math.h>
+#include <stdlib.h>
+
+// No tessellation has been built yet
+#define PATH_NO_BUCKET (-1000)
+
+Path *path_create(void)
+{
+    Path *path = calloc(1, sizeof(Path));
+
+    path->bucket = PATH_NO_BUCKET;
+    path->dirty = true;
+
+    return path;
+}
+
+void path_destroy(Path *path)
+{
+    free(path->commands);
+    free(path->points);
+    free(path->flat);
+    free(path->contours);
+    free(path->fill_quads);
+    free(path->stroke_quads);
+    free(path->scratch);
+    free(path);
+}
+
+void path_clear(Path *path)
+{
+    path->num_commands = 0;
+    path->num_points = 0;
+    path->dirty = true;
+}
+
+void path_move_to(Path *path, Vec2 point)
+{
+    path_push(path, PATH_MOVE_TO, &point, 1);
+}
+
+void path_line_to(Path *path, Vec2 point)
+{
+    path_push(path, PATH_LINE_TO, &point, 1);
+}
+
+void path_quad_to(Path *path, Vec2 control, Vec2 point)
+{
+    Vec2 points[2];
+    points[0] = control;
+    points[1] = point;
+
+    path_push(path, PATH_QUAD_TO, points, 2);
+}
+
+void path_cubic_to(Path *path, Vec2 control1, Vec2 control2, Vec2 point)
+{
+    Vec2 points[3];
+    points[0] = control1;
+    points[1] = control2;
+    points[2] = point;
+
+    path_push(path, PATH_CUBIC_TO, points, 3);
+}
+
+void path_close(Path *path)
+{
+    path_push(path, PATH_CLOSE, NULL, 0);
+}
+
+void batch_fill_path(Batch *batch, Path *path, Vec4 color)
+{
+    if (batch->flags & BATCH_INSTANCED)
+        return;
+
+    path_tessellate(path, path_scale_bucket(batch));
+
+    if (!path->filled)
+        path_fill(path);
+
+    BatchVertex corners[4];
+
+    unsigned int i, k;
+    for (i = 0; i < path->num_fill_quads; i++)
+    {
+        for (k = 0; k < 4; k++)
+            corners[k] = (BatchVertex){path->flat[path->fill_quads[i * 4 + k]], {0, 0}, color};
+
+        batch_emit_vertices(batch, corners, NULL);
+    }
+}
+
+void batch_stroke_path(Batch *batch, Path *path, Vec4 color, float width)
+{
+    if (batch->frozen)
+        return;
+
+    path_tessellate(path, path_scale_bucket(batch));
+
+    // The expanded quads hold until the path, scale bucket or line style changes
+    if (!path->stroked || path->stroke_width != width || path->stroke_join != batch->line_join || path->stroke_cap != batch->line_cap)
+        path_stroke(path, width, batch->line_join, batch->line_cap);
+
+    unsigned int i;
+    for (i = 0; i < path->num_stroke_quads; i++)
+        batch_push_line_quad(batch, &path->stroke_quads[i], color);
+}
+
+void path_push(Path *path, PathCommand command, const Vec2 *points, unsigned int count)
+{
+    if (path->num_commands == path->max_commands)
+    {
+        path->max_commands = path->max_commands ? path->max_commands * 2 : 16;
+        path->commands = realloc(path->commands, path->max_commands);
+    }
+
+    while (path->num_points + count > path->max_points)
+    {
+        path->max_points = path->max_points ? path->max_points * 2 : 32;
+        path->points = realloc(path->points, path->max_points * sizeof(Vec2));
+    }
+
+    path->commands[path->num_commands++] = (unsigned char)command;
+
+    unsigned int i;
+    for (i = 0; i < count; i++)
+        path->points[path->num_points++] = points[i];
+
+    path->dirty = true;
+}
+
+int path_scale_bucket(Batch *batch)
+{
+    Transform2D t = batch->transform;
+    float scale = sqrtf(fabsf(t.m00 * t.m11 - t.m01 * t.m10));
+
+    if (scale < 1e-6f)
+        scale = 1e-6f;
+
+    // Half octave buckets, so zooming doesn't rebuild every frame
+    return (int)ceilf(log2f(scale) * 2.0f);
+}
+
+void path_tessellate(Path *path, int bucket)
+{
+    if (!path->dirty && path->bucket == bucket)
+        return;
+
+    // Flatten for the largest scale in the bucket so it holds for all of them
+    float tolerance = PATH_TOLERANCE / powf(2.0f, bucket * 0.5f);
+
+    path->num_flat = 0;
+    path->num_contours = 0;
+
+    Vec2 current = {0, 0}, start = {0, 0};
+    bool open = false;
+
+    unsigned int i, p = 0;
+    for (i = 0; i < path->num_commands; i++)
+    {
+        PathCommand command = path->commands[i];
+
+        if (command == PATH_MOVE_TO)
+        {
+            current = start = path->points[p++];
+            open = false;
+            continue;
+        }
+
+        if (command == PATH_CLOSE)
+        {
+            if (open)
+                path->contours[path->num_contours - 1].closed = true;
+
+            current = start;
+            open = false;
+            continue;
+        }
+
+        if (!open)
+        {
+            if (path->num_contours == path->max_contours)
+            {
+                path->max_contours = path->max_contours ? path->max_contours * 2 : 4;
+                path->contours = realloc(path->contours, path->max_contours * sizeof(PathContour));
+            }
+
+            path->contours[path->num_contours++] = (PathContour){path->num_flat, 0, false};
+            path_flat_point(path, current);
+            start = current;
+            open = true;
+        }
+
+        unsigned int segments = 1, s;
+        Vec2 p0 = current;
+
+        if (command == PATH_LINE_TO)
+        {
+            current = path->points[p++];
+            path_flat_point(path, current);
+        }
+        else if (command == PATH_QUAD_TO)
+        {
+            Vec2 p1 = path->points[p], p2 = path->points[p + 1];
+            p += 2;
+
+            segments = path_curve_segments(vec2_magnitude((Vec2){p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y}) * 2.0f, tolerance);
+
+            for (s = 1; s <= segments; s++)
+            {
+                float t = (float)s / segments, u = 1 - t;
+                path_flat_point(path, (Vec2){u * u * p0.x + 2 * u * t * p1.x + t * t * p2.x,
+                                             u * u * p0.y + 2 * u * t * p1.y + t * t * p2.y});
+            }
+
+            current = p2;
+        }
+        else
+        {
+            Vec2 p1 = path->points[p], p2 = path->points[p + 1], p3 = path->points[p + 2];
+            p += 3;
+
+            float d1 = vec2_magnitude((Vec2){p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y});
+            float d2 = vec2_magnitude((Vec2){p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y});
+            segments = path_curve_segments((d1 > d2 ? d1 : d2) * 6.0f, tolerance);
+
+            for (s = 1; s <= segments; s++)
+            {
+                float t = (float)s / segments, u = 1 - t;
+                float a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+                path_flat_point(path, (Vec2){a * p0.x + b * p1.x + c * p2.x + d * p3.x,
+                                             a * p0.y + b * p1.y + c * p2.y + d * p3.y});
+            }
+
+            current = p3;
+        }
+    }
+
+    // A closed contour that returned to its start would repeat it
+    for (i = 0; i < path->num_contours; i++)
+    {
+        PathContour *contour = &path->contours[i];
+        Vec2 first = path->flat[contour->first], last = path->flat[contour->first + contour->count - 1];
+
+        if (contour->closed && contour->count > 1 && first.x == last.x && first.y == last.y)
+            contour->count--;
+    }
+
+    path->bucket = bucket;
+    path->dirty = false;
+    path->filled = false;
+    path->stroked = false;
+}
+
+void path_fill(Path *path)
+{
+    path->num_fill_quads = 0;
+
+    unsigned int i, k;
+    for (i = 0; i < path->num_contours; i++)
+    {
+        PathContour *contour = &path->contours[i];
+        unsigned int count = contour->count;
+
+        if (count < 3)
+            continue;
+
+        // The points left to clip followed by the triangles cut off
+        unsigned int needed = count + 3 * (count - 2);
+        if (needed > path->max_scratch)
+        {
+            path->max_scratch = needed;
+            path->scratch = realloc(path->scratch, needed * sizeof(unsigned int));
+        }
+
+        while (path->num_fill_quads + count - 2 > path->max_fill_quads)
+        {
+            path->max_fill_quads = path->max_fill_quads ? path->max_fill_quads * 2 : 64;
+            path->fill_quads = realloc(path->fill_quads, path->max_fill_quads * 4 * sizeof(unsigned int));
+        }
+
+        unsigned int *triangles = path->scratch + count;
+        unsigned int num_triangles = batch_triangulate(path->flat + contour->first, count, path->scratch, triangles);
+
+        unsigned int *quads = path->fill_quads + path->num_fill_quads * 4;
+        unsigned int num_quads = batch_pack_triangles(triangles, num_triangles, quads);
+
+        for (k = 0; k < num_quads * 4; k++)
+            quads[k] += contour->first;
+
+        path->num_fill_quads += num_quads;
+    }
+
+    path->filled = true;
+}
+
+void path_stroke(Path *path, float width, LineJoin join, LineCap cap)
+{
+    path->num_stroke_quads = 0;
+
+    unsigned int i;
+    for (i = 0; i < path->num_contours; i++)
+    {
+        PathContour *contour = &path->contours[i];
+        path->num_stroke_quads = batch_expand_polyline(path->flat + contour->first, contour->count, width, contour->closed, join, cap, &path->stroke_quads, &path->max_stroke_quads, path->num_stroke_quads);
+    }
+
+    path->stroke_width = width;
+    path->stroke_join = join;
+    path->stroke_cap = cap;
+    path->stroked = true;
+}
+
+void path_flat_point(Path *path, Vec2 point)
+{
+    PathContour *contour = &path->contours[path->num_contours - 1];
+
+    // Repeated points give zero length edges that strokes can't orient
+    if (contour->count)
+    {
+        Vec2 last = path->flat[path->num_flat - 1];
+        if (last.x == point.x && last.y == point.y)
+            return;
+    }
+
+    if (path->num_flat == path->max_flat)
+    {
+        path->max_flat = path->max_flat ? path->max_flat * 2 : 64;
+        path->flat = realloc(path->flat, path->max_flat * sizeof(Vec2));
+    }
+
+    path->flat[path->num_flat++] = point;
+    contour->count++;
+}
+
+unsigned int path_curve_segments(float deviation, float tolerance)
+{
+    // Chords of a curve split into n even steps stray at most |B''| / (8 n^2)
+    float segments = ceilf(sqrtf(deviation / (8.0f * tolerance)));
+
+    if (!(segments >= 1))
+        return 1;
+    if (segments > PATH_MAX_SEGMENTS)
+        return PATH_MAX_SEGMENTS;
+
+    return (unsigned int)segments;
+}
@@ -0,0 +1,341 @@
+#include "shlib_internal.h"
+#include <stdlib.h>
+
+// Node index of the first cell of a level, the levels are stored one after another
+#define SCENE_LEVEL_OFFSET(level) (((1u << (2 * (level))) - 1) / 3)
+
+// Sprite is in the list of things outside of the scene bounds
+#define SCENE_OUTSIDE (-1)
+// Sprite slot is on the free list
+#define SCENE_FREE (-2)
+
+Scene *scene_create(Vec2 min, Vec2 max, unsigned int depth)
+{
+    Scene *scene = malloc(sizeof(Scene));
+
+    if (depth < 1)
+        depth = 1;
+    if (depth > SCENE_MAX_DEPTH)
+        depth = SCENE_MAX_DEPTH;
+
+    scene->min = min;
+    scene->max = max;
+    scene->depth = depth;
+
+    scene->num_nodes = SCENE_LEVEL_OFFSET(depth);
+    scene->heads = malloc(scene->num_nodes * sizeof(int));
+    scene->counts = calloc(scene->num_nodes, sizeof(unsigned int));
+    scene->outside = -1;
+
+    unsigned int i;
+    for (i = 0; i < scene->num_nodes; i++)
+        scene->heads[i] = -1;
+
+    scene->sprites = NULL;
+    scene->num_sprites = 0;
+    scene->max_sprites = 0;
+    scene->free_list = -1;
+
+    scene->stats = (SceneStats){0, 0, 0};
+
+    return scene;
+}
+
+void scene_destroy(Scene *scene)
+{
+    free(scene->heads);
+    free(scene->counts);
+    free(scene->sprites);
+    free(scene);
+}
+
+unsigned int scene_add_sprite(Scene *scene, Vec2 position, Vec2 size, Vec4 color, Texture *texture)
+{
+    unsigned int id;
+
+    if (scene->free_list >= 0)
+    {
+        id = scene->free_list;
+        scene->free_list = scene->sprites[id].next;
+    }
+    else
+    {
+        if (scene->num_sprites == scene->max_sprites)
+        {
+            scene->max_sprites = scene->max_sprites ? scene->max_sprites * 2 : 64;
+            scene->sprites = realloc(scene->sprites, scene->max_sprites * sizeof(SceneSprite));
+        }
+
+        id = scene->num_sprites++;
+    }
+
+    SceneSprite *sprite = &scene->sprites[id];
+    sprite->position = position;
+    sprite->size = size;
+    sprite->uv_rect = (Vec4){0, 0, 1, 1};
+    sprite->color = color;
+    sprite->texture = texture;
+
+    scene_link(scene, id, scene_node_for(scene, position, size));
+
+    return id;
+}
+
+void scene_set_sprite_uv(Scene *scene, unsigned int id, Vec4 uv_rect)
+{
+    scene->sprites[id].uv_rect = uv_rect;
+}
+
+void scene_update_sprite(Scene *scene, unsigned int id, Vec2 position, Vec2 size)
+{
+    if (id >= scene->num_sprites || scene->sprites[id].node == SCENE_FREE)
+        return;
+
+    SceneSprite *sprite = &scene->sprites[id];
+    int node = scene_node_for(scene, position, size);
+
+    sprite->position = position;
+    sprite->size = size;
+
+    // Most moves stay inside the loose bounds of the same cell
+    if (node == sprite->node)
+        return;
+
+    scene_unlink(scene, id);
+    scene_link(scene, id, node);
+}
+
+void scene_remove_sprite(Scene *scene, unsigned int id)
+{
+    if (id >= scene->num_sprites || scene->sprites[id].node == SCENE_FREE)
+        return;
+
+    SceneSprite *sprite = &scene->sprites[id];
+
+    scene_unlink(scene, id);
+
+    sprite->node = SCENE_FREE;
+    sprite->next = scene->free_list;
+    scene->free_list = id;
+}
+
+void scene_draw(Scene *scene, Batch *batch, Matrix projection)
+{
+    // Undo the orthographic projection on the corners of clip space
+    float x0 = (-1 - projection.m03) / projection.m00;
+    float x1 = (1 - projection.m03) / projection.m00;
+    float y0 = (-1 - projection.m13) / projection.m11;
+    float y1 = (1 - projection.m13) / projection.m11;
+
+    Vec4 view;
+    view.x = x0 < x1 ? x0 : x1;
+    view.z = x0 < x1 ? x1 : x0;
+    view.y = y0 < y1 ? y0 : y1;
+    view.w = y0 < y1 ? y1 : y0;
+
+    unsigned int live = scene->counts[0];
+    SceneStats stats = {0, 0, 0};
+    scene->stats = stats;
+
+    scene_query(scene, batch, 0, 0, 0, view);
+    scene_emit_list(scene, batch, scene->outside, &view);
+
+    int i;
+    for (i = scene->outside; i >= 0; i = scene->sprites[i].next)
+        live++;
+
+    scene->stats.culled = live - scene->stats.drawn;
+}
+
+SceneStats scene_get_stats(Scene *scene)
+{
+    return scene->stats;
+}
+
+int scene_node_for(Scene *scene, Vec2 position, Vec2 size)
+{
+    float width = scene->max.x - scene->min.x;
+    float height = scene->max.y - scene->min.y;
+    float cx = position.x - scene->min.x;
+    float cy = position.y - scene->min.y;
+
+    if (cx < 0 || cy < 0 || cx >= width || cy >= height)
+        return SCENE_OUTSIDE;
+
+    // Loose cells reach half a cell past each edge, so anything no bigger
+    // than a cell fits in the one its center lands in
+    unsigned int level = 0;
+    while (level + 1 < scene->depth)
+    {
+        float cells = (float)(1u << (level + 1));
+        if (size.x > width / cells || size.y > height / cells)
+            break;
+        level++;
+    }
+
+    unsigned int cells = 1u << level;
+    unsigned int x = (unsigned int)(cx / width * cells);
+    unsigned int y = (unsigned int)(cy / height * cells);
+
+    if (x >= cells)
+        x = cells - 1;
+    if (y >= cells)
+        y = cells - 1;
+
+    return (int)(SCENE_LEVEL_OFFSET(level) + y * cells + x);
+}
+
+void scene_link(Scene *scene, unsigned int id, int node)
+{
+    SceneSprite *sprite = &scene->sprites[id];
+    int *head = node == SCENE_OUTSIDE ? &scene->outside : &scene->heads[node];
+
+    sprite->node = node;
+    sprite->prev = -1;
+    sprite->next = *head;
+    if (*head >= 0)
+        scene->sprites[*head].prev = id;
+    *head = id;
+
+    if (node == SCENE_OUTSIDE)
+        return;
+
+    // Walk up to the root so empty subtrees can be skipped while drawing
+    unsigned int level = 0;
+    while (SCENE_LEVEL_OFFSET(level + 1) <= (unsigned int)node)
+        level++;
+
+    unsigned int index = node - SCENE_LEVEL_OFFSET(level);
+    unsigned int x = index & ((1u << level) - 1), y = index >> level;
+
+    for (;;)
+    {
+        scene->counts[SCENE_LEVEL_OFFSET(level) + (y << level) + x]++;
+        if (!level)
+            break;
+        level--;
+        x >>= 1;
+        y >>= 1;
+    }
+}
+
+void scene_unlink(Scene *scene, unsigned int id)
+{
+    SceneSprite *sprite = &scene->sprites[id];
+    int node = sprite->node;
+    int *head = node == SCENE_OUTSIDE ? &scene->outside : &scene->heads[node];
+
+    if (sprite->prev >= 0)
+        scene->sprites[sprite->prev].next = sprite->next;
+    else
+        *head = sprite->next;
+    if (sprite->next >= 0)
+        scene->sprites[sprite->next].prev = sprite->prev;
+
+    if (node == SCENE_OUTSIDE)
+        return;
+
+    unsigned int level = 0;
+    while (SCENE_LEVEL_OFFSET(level + 1) <= (unsigned int)node)
+        level++;
+
+    unsigned int index = node - SCENE_LEVEL_OFFSET(level);
+    unsigned int x = index & ((1u << level) - 1), y = index >> level;
+
+    for (;;)
+    {
+        scene->counts[SCENE_LEVEL_OFFSET(level) + (y << level) + x]--;
+        if (!level)
+            break;
+        level--;
+        x >>= 1;
+        y >>= 1;
+    }
+}
+
+void scene_query(Scene *scene, Batch *batch, unsigned int level, unsigned int x, unsigned int y, Vec4 view)
+{
+    unsigned int node = SCENE_LEVEL_OFFSET(level) + (y << level) + x;
+
+    if (!scene->counts[node])
+        return;
+
+    scene->stats.nodes_visited++;
+
+    float cell_w = (scene->max.x - scene->min.x) / (float)(1u << level);
+    float cell_h = (scene->max.y - scene->min.y) / (float)(1u << level);
+
+    // Loose bounds of the cell
+    float left = scene->min.x + (x - 0.5f) * cell_w;
+    float top = scene->min.y + (y - 0.5f) * cell_h;
+    float right = left + cell_w * 2;
+    float bottom = top + cell_h * 2;
+
+    if (right < view.x || left > view.z || bottom < view.y || top > view.w)
+        return;
+
+    if (left >= view.x && right <= view.z && top >= view.y && bottom <= view.w)
+    {
+        scene_emit_all(scene, batch, level, x, y);
+        return;
+    }
+
+    scene_emit_list(scene, batch, scene->heads[node], &view);
+
+    if (level + 1 >= scene->depth)
+        return;
+
+    scene_query(scene, batch, level + 1, x * 2, y * 2, view);
+    scene_query(scene, batch, level + 1, x * 2 + 1, y * 2, view);
+    scene_query(scene, batch, level + 1, x * 2, y * 2 + 1, view);
+    scene_query(scene, batch, level + 1, x * 2 + 1, y * 2 + 1, view);
+}
+
+void scene_emit_list(Scene *scene, Batch *batch, int head, const Vec4 *view)
+{
+    int i;
+    for (i = head; i >= 0; i = scene->sprites[i].next)
+    {
+        SceneSprite *sprite = &scene->sprites[i];
+
+        // Sprites are positioned by their center
+        float half_w = sprite->size.x * 0.5f;
+        float half_h = sprite->size.y * 0.5f;
+
+        if (sprite->position.x + half_w < view->x || sprite->position.x - half_w > view->z ||
+            sprite->position.y + half_h < view->y || sprite->position.y - half_h > view->w)
+            continue;
+
+        scene_emit_sprite(scene, batch, sprite);
+    }
+}
+
+void scene_emit_all(Scene *scene, Batch *batch, unsigned int level, unsigned int x, unsigned int y)
+{
+    unsigned int node = SCENE_LEVEL_OFFSET(level) + (y << level) + x;
+
+    if (!scene->counts[node])
+        return;
+
+    int i;
+    for (i = scene->heads[node]; i >= 0; i = scene->sprites[i].next)
+        scene_emit_sprite(scene, batch, &scene->sprites[i]);
+
+    if (level + 1 >= scene->depth)
+        return;
+
+    scene_emit_all(scene, batch, level + 1, x * 2, y * 2);
+    scene_emit_all(scene, batch, level + 1, x * 2 + 1, y * 2);
+    scene_emit_all(scene, batch, level + 1, x * 2, y * 2 + 1);
+    scene_emit_all(scene, batch, level + 1, x * 2 + 1, y * 2 + 1);
+}
+
+void scene_emit_sprite(Scene *scene, Batch *batch, SceneSprite *sprite)
+{
+    Vec2 uv[4];
+
+    batch_rect_uv(sprite->uv_rect, uv);
+    batch_add_sprite_transformed(batch, (Transform2D){sprite->size.x, 0, sprite->position.x, 0, sprite->size.y, sprite->position.y}, uv, sprite->color, sprite->texture);
+
+    scene->stats.drawn++;
+}
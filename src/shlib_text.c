@@ -0,0 +1,634 @@
+#include "shlib_internal.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stb_truetype.h>
+
+TextRun *text_run_create(Font *font, const char *text, Vec2 position, float size, Vec4 color)
+{
+    TextRun *run = calloc(1, sizeof(TextRun));
+    size_t length = strlen(text);
+
+    run->font = font;
+    run->text = malloc(length + 1);
+    memcpy(run->text, text, length + 1);
+    run->position = position;
+    run->size = size;
+    run->color = color;
+
+    text_run_layout(run);
+
+    return run;
+}
+
+void text_run_destroy(TextRun *run)
+{
+    free(run->text);
+    free(run->glyphs);
+    free(run->shelves);
+    free(run->vertices);
+    free(run);
+}
+
+void batch_add_text_run(Batch *batch, TextRun *run)
+{
+    Font *font = run->font;
+
+    if (font->cache && run->generation != font->cache->generation)
+        text_run_layout(run);
+
+    // Drawing from the glyphs has to keep them from being evicted, same as a lookup would
+    unsigned int i;
+    for (i = 0; i < run->num_shelves; i++)
+    {
+        GlyphShelf *shelf = &font->cache->shelves[run->shelves[i]];
+        shelf->last_used = ++font->cache->tick;
+        shelf->frame = graphics.frame;
+    }
+
+    if ((batch->flags & BATCH_DEFERRED) || batch->transformed || batch->num_clips || run->num_glyphs > batch->max_draw_elements)
+    {
+        for (i = 0; i < run->num_glyphs; i++)
+            batch_emit_glyph(batch, &run->glyphs[i], run->color, font->bitmap);
+
+        return;
+    }
+
+    if (!run->num_glyphs || !batch_reserve(batch, &batch->quads, run->num_glyphs))
+        return;
+
+    if (run->num_shelves)
+        batch->cached_glyphs = true;
+
+    int slot = batch_texture_slot(batch, font->bitmap);
+
+    if (slot < 0)
+        return;
+
+    // Everything the written vertices depend on besides the glyphs themselves
+    unsigned int format = (batch->flags & (BATCH_INSTANCED | BATCH_COMPACT | BATCH_PREMULTIPLIED_ALPHA)) | (batch->blend << 16);
+
+    if (!run->has_vertices || run->vertex_format != format || run->vertex_depth != batch->depth || run->vertex_slot != slot)
+    {
+        Vec4 color = batch_blend_color(batch, run->color);
+
+        run->vertices = realloc(run->vertices, run->num_glyphs * batch->quads.size);
+
+        for (i = 0; i < run->num_glyphs; i++)
+        {
+            TextRunGlyph *glyph = &run->glyphs[i];
+            batch_write_quad((unsigned char *)run->vertices + i * batch->quads.size, batch->flags, batch->depth, glyph->position, glyph->size, glyph->uv, color, slot);
+        }
+
+        run->vertex_format = format;
+        run->vertex_depth = batch->depth;
+        run->vertex_slot = slot;
+        run->has_vertices = true;
+    }
+
+    memcpy((unsigned char *)batch->quads.data + batch->quads.count * batch->quads.size, run->vertices, run->num_glyphs * batch->quads.size);
+    batch->quads.count += run->num_glyphs;
+}
+
+TextRunCache *text_run_cache_create(void)
+{
+    TextRunCache *cache = calloc(1, sizeof(TextRunCache));
+
+    cache->num_buckets = 64;
+    cache->buckets = calloc(cache->num_buckets, sizeof(TextRun *));
+    cache->frame = graphics.frame;
+
+    return cache;
+}
+
+void text_run_cache_destroy(TextRunCache *cache)
+{
+    text_run_cache_clear(cache);
+    free(cache->buckets);
+    free(cache);
+}
+
+void text_run_cache_clear(TextRunCache *cache)
+{
+    unsigned int i;
+    for (i = 0; i < cache->num_buckets; i++)
+    {
+        while (cache->buckets[i])
+        {
+            TextRun *run = cache->buckets[i];
+            cache->buckets[i] = run->next;
+            text_run_destroy(run);
+        }
+    }
+
+    cache->num_runs = 0;
+}
+
+TextRun *text_run_cache_get(TextRunCache *cache, Font *font, const char *text, Vec2 position, float size, Vec4 color)
+{
+    if (cache->frame != graphics.frame)
+        text_run_cache_sweep(cache);
+
+    unsigned int hash = text_run_hash(font, text, position, size, color);
+    TextRun *run;
+
+    for (run = cache->buckets[hash & (cache->num_buckets - 1)]; run; run = run->next)
+    {
+        if (run->hash == hash && run->font == font && run->size == size &&
+            run->position.x == position.x && run->position.y == position.y &&
+            run->color.x == color.x && run->color.y == color.y && run->color.z == color.z && run->color.w == color.w &&
+            !strcmp(run->text, text))
+        {
+            run->last_frame = graphics.frame;
+            return run;
+        }
+    }
+
+    unsigned int i;
+    if (cache->num_runs >= cache->num_buckets)
+    {
+        unsigned int num_buckets = cache->num_buckets * 2;
+        TextRun **buckets = calloc(num_buckets, sizeof(TextRun *));
+
+        for (i = 0; i < cache->num_buckets; i++)
+        {
+            while (cache->buckets[i])
+            {
+                TextRun *moved = cache->buckets[i];
+                cache->buckets[i] = moved->next;
+
+                moved->next = buckets[moved->hash & (num_buckets - 1)];
+                buckets[moved->hash & (num_buckets - 1)] = moved;
+            }
+        }
+
+        free(cache->buckets);
+        cache->buckets = buckets;
+        cache->num_buckets = num_buckets;
+    }
+
+    run = text_run_create(font, text, position, size, color);
+    run->hash = hash;
+    run->last_frame = graphics.frame;
+    run->next = cache->buckets[hash & (cache->num_buckets - 1)];
+    cache->buckets[hash & (cache->num_buckets - 1)] = run;
+    cache->num_runs++;
+
+    return run;
+}
+
+void batch_add_text_cached(Batch *batch, TextRunCache *cache, Vec2 position, Font *font, const char *text, float size, Vec4 color)
+{
+    batch_add_text_run(batch, text_run_cache_get(cache, font, text, position, size, color));
+}
+
+Vec2 text_measure(Font *font, const char *text, float size)
+{
+    float scale = size / font->size, widest = 0;
+    unsigned int lines = 1;
+
+    for (;;)
+    {
+        const char *end = strchr(text, '\n');
+        float width = text_width(font, text, end, scale);
+
+        if (width > widest)
+            widest = width;
+
+        if (!end)
+            break;
+
+        text = end + 1;
+        lines++;
+    }
+
+    return (Vec2){widest, (font->ascent - font->descent) * scale + (lines - 1) * font_get_line_height(font, size)};
+}
+
+float font_get_line_height(Font *font, float size)
+{
+    return (font->ascent - font->descent + font->line_gap) * size / font->size;
+}
+
+unsigned int text_wrap(Font *font, const char *text, float size, float max_width, unsigned int line_limit, TextLine **lines, unsigned int *max_lines)
+{
+    float scale = size / font->size, width = 0;
+    const char *s = text, *line = text;
+    // Last space on the line, where it can end without splitting a word
+    const char *space = NULL;
+    // Where the line's first word starts, after any indentation
+    const char *first = NULL;
+    unsigned int prev = 0, count = 0;
+
+    for (;;)
+    {
+        const char *at = s;
+        unsigned int codepoint = *s ? utils_utf8_decode(&s) : 0;
+
+        if (codepoint && codepoint != '\n')
+        {
+            if (codepoint < 32)
+                continue;
+
+            float advance = (font_get_kerning(font, prev, codepoint) + font_get_advance(font, codepoint)) * scale;
+
+            // Indentation before the first word stays on its line
+            if (codepoint == ' ')
+            {
+                if (first)
+                    space = at;
+            }
+            else if (max_width > 0 && width + advance > max_width && at > line)
+            {
+                // Unless the first word doesn't fit after it, then it goes before the word is split
+                const char *start = first ? first : at;
+                if (!space && start > line)
+                {
+                    line = start;
+                    width = text_width(font, line, at, scale);
+
+                    if (line == at)
+                        advance = font_get_advance(font, codepoint) * scale;
+                }
+            }
+
+            if (codepoint != ' ' && max_width > 0 && width + advance > max_width && at > line)
+            {
+                const char *cut = space ? space : at;
+
+                while (space && cut[-1] == ' ')
+                    cut--;
+
+                if (line_limit && count + 1 == line_limit)
+                    return text_wrap_truncate(font, text, line, scale, max_width, lines, max_lines, count);
+
+                count = text_wrap_push(lines, max_lines, count, text, line, cut, text_width(font, line, cut, scale), false);
+
+                // The word that didn't fit starts the next line
+                line = space ? space + 1 : at;
+                while (*line == ' ')
+                    line++;
+
+                space = NULL;
+                first = line;
+                width = text_width(font, line, at, scale);
+
+                if (line == at)
+                    advance = font_get_advance(font, codepoint) * scale;
+            }
+
+            if (codepoint != ' ' && !first)
+                first = at;
+
+            width += advance;
+            prev = codepoint;
+            continue;
+        }
+
+        // Trailing spaces are left off as they are where lines wrap
+        const char *end = at;
+        while (end > line && end[-1] == ' ')
+            end--;
+
+        if (end < at)
+            width = text_width(font, line, end, scale);
+
+        // Text after a newline is one line too many, if any of it shows
+        if (codepoint && line_limit && count + 1 == line_limit)
+        {
+            if (text_has_content(s))
+                return text_wrap_truncate(font, text, line, scale, max_width, lines, max_lines, count);
+
+            return text_wrap_push(lines, max_lines, count, text, line, end, width, false);
+        }
+
+        count = text_wrap_push(lines, max_lines, count, text, line, end, width, false);
+
+        if (!codepoint)
+            return count;
+
+        line = s;
+        space = NULL;
+        first = NULL;
+        width = 0;
+        prev = 0;
+    }
+}
+
+void batch_add_text_wrapped(Batch *batch, Vec2 position, Font *font, const char *text, float size, Vec4 color, float max_width, unsigned int line_limit)
+{
+    unsigned int count = text_wrap(font, text, size, max_width, line_limit, &batch->text_lines, &batch->max_text_lines);
+    float line_height = font_get_line_height(font, size);
+
+    unsigned int i;
+    for (i = 0; i < count; i++)
+    {
+        TextLine *line = &batch->text_lines[i];
+        Vec2 origin = {position.x, position.y - i * line_height};
+
+        batch_add_text_span(batch, origin, font, text + line->start, text + line->start + line->length, size, color);
+
+        if (line->ellipsis)
+            batch_add_text_span(batch, (Vec2){origin.x + line->width, origin.y}, font, text_ellipsis(font), NULL, size, color);
+    }
+}
+
+unsigned int text_layout(Font *font, const char *text, const char *end, Vec2 position, float size, TextRunGlyph **glyphs, unsigned int *max_glyphs)
+{
+    float x = position.x, y = position.y;
+    float scale = size / font->size;
+    float inv_width = 1.0f / font->bitmap->width, inv_height = 1.0f / font->bitmap->height;
+    unsigned int count = 0, prev = 0;
+
+    // Pixel snapping only helps glyphs drawn at the size they were rasterized at, oversampling wants subpixel positions
+    bool snap = scale == 1.0f && !font->sdf && font->oversample_x <= 1 && font->oversample_y <= 1;
+
+    while (*text && text != end)
+    {
+        unsigned int codepoint = utils_utf8_decode(&text);
+
+        if (codepoint == '\n')
+        {
+            x = position.x;
+            y -= font_get_line_height(font, size);
+            prev = 0;
+            continue;
+        }
+
+        if (codepoint < 32)
+            continue;
+
+        x += font_get_kerning(font, prev, codepoint) * scale;
+        prev = codepoint;
+
+        unsigned int gx, gy, width, height;
+        float xoff, yoff, xadvance, quad_width, quad_height;
+        int shelf = -1;
+
+        if (font->cache)
+        {
+            GlyphCacheEntry *entry = glyph_cache_get(font->cache, font, codepoint);
+
+            // Keep the spacing text_measure expects even without room for the glyph
+            if (!entry)
+            {
+                x += font_get_advance(font, codepoint) * scale;
+                continue;
+            }
+
+            gx = entry->x;
+            gy = entry->y;
+            width = entry->width;
+            height = entry->height;
+            xoff = entry->xoff;
+            yoff = entry->yoff;
+            xadvance = entry->xadvance;
+            quad_width = width;
+            quad_height = height;
+            shelf = entry->shelf;
+        }
+        else
+        {
+            Character *c = font_get_character(font, codepoint);
+
+            if (!c)
+            {
+                x += font_get_advance(font, codepoint) * scale;
+                continue;
+            }
+
+            gx = c->x0;
+            gy = c->y0;
+            width = c->x1 - c->x0;
+            height = c->y1 - c->y0;
+            xoff = c->xoff;
+            yoff = c->yoff;
+            xadvance = c->xadvance;
+            // Oversampled glyphs cover fewer pixels on screen than in the atlas
+            quad_width = c->xoff2 - c->xoff;
+            quad_height = c->yoff2 - c->yoff;
+        }
+
+        // Glyph offsets are y down from the baseline, the batch is y up
+        float left = x + xoff * scale;
+        float top = y - yoff * scale;
+
+        if (snap)
+        {
+            left = floorf(left + 0.5f);
+            top = floorf(top + 0.5f);
+        }
+
+        x += xadvance * scale;
+
+        if (!width || !height)
+            continue;
+
+        if (count == *max_glyphs)
+        {
+            *max_glyphs = *max_glyphs ? *max_glyphs * 2 : 64;
+            *glyphs = realloc(*glyphs, *max_glyphs * sizeof(TextRunGlyph));
+        }
+
+        TextRunGlyph *glyph = &(*glyphs)[count++];
+
+        glyph->size = (Vec2){quad_width * scale, quad_height * scale};
+        glyph->position = (Vec2){left + glyph->size.x / 2.0f, top - glyph->size.y / 2.0f};
+        glyph->uv[0] = (Vec2){gx * inv_width, gy * inv_height};
+        glyph->uv[1] = (Vec2){(gx + width) * inv_width, gy * inv_height};
+        glyph->uv[2] = (Vec2){(gx + width) * inv_width, (gy + height) * inv_height};
+        glyph->uv[3] = (Vec2){gx * inv_width, (gy + height) * inv_height};
+        glyph->shelf = shelf;
+    }
+
+    return count;
+}
+
+void text_run_layout(TextRun *run)
+{
+    run->num_glyphs = text_layout(run->font, run->text, NULL, run->position, run->size, &run->glyphs, &run->max_glyphs);
+    run->num_shelves = 0;
+    run->has_vertices = false;
+
+    // A label rarely spans more than a couple of shelves
+    unsigned int i, k;
+    for (i = 0; i < run->num_glyphs; i++)
+    {
+        int shelf = run->glyphs[i].shelf;
+
+        if (shelf < 0)
+            continue;
+
+        for (k = 0; k < run->num_shelves; k++)
+        {
+            if (run->shelves[k] == shelf)
+                break;
+        }
+
+        if (k < run->num_shelves)
+            continue;
+
+        if (run->num_shelves == run->max_shelves)
+        {
+            run->max_shelves = run->max_shelves ? run->max_shelves * 2 : 4;
+            run->shelves = realloc(run->shelves, run->max_shelves * sizeof(int));
+        }
+
+        run->shelves[run->num_shelves++] = shelf;
+    }
+
+    run->generation = run->font->cache ? run->font->cache->generation : 0;
+}
+
+void batch_emit_glyph(Batch *batch, const TextRunGlyph *glyph, Vec4 color, Texture *texture)
+{
+    // Glyph cache texels can be evicted, so this batch mustn't be frozen
+    if (glyph->shelf >= 0)
+        batch->cached_glyphs = true;
+
+    if ((batch->flags & BATCH_DEFERRED) || batch->transformed)
+        batch_add_transformed(batch, (Transform2D){glyph->size.x, 0, glyph->position.x, 0, glyph->size.y, glyph->position.y}, glyph->uv, color, texture);
+    else
+        batch_emit_quad(batch, glyph->position, glyph->size, glyph->uv, color, texture);
+}
+
+unsigned int text_run_hash(Font *font, const char *text, Vec2 position, float size, Vec4 color)
+{
+    float key[7];
+    key[0] = position.x;
+    key[1] = position.y;
+    key[2] = size;
+    key[3] = color.x;
+    key[4] = color.y;
+    key[5] = color.z;
+    key[6] = color.w;
+
+    // FNV-1a over the key, then the string
+    unsigned int hash = 2166136261u ^ (unsigned int)((size_t)font >> 4);
+    const unsigned char *bytes = (const unsigned char *)key;
+
+    unsigned int i;
+    for (i = 0; i < sizeof(key); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+
+    for (bytes = (const unsigned char *)text; *bytes; bytes++)
+        hash = (hash ^ *bytes) * 16777619u;
+
+    return hash;
+}
+
+void text_run_cache_sweep(TextRunCache *cache)
+{
+    unsigned int i;
+    for (i = 0; i < cache->num_buckets; i++)
+    {
+        TextRun **link = &cache->buckets[i];
+
+        while (*link)
+        {
+            TextRun *run = *link;
+
+            if (graphics.frame - run->last_frame <= TEXT_RUN_CACHE_MAX_AGE)
+            {
+                link = &run->next;
+                continue;
+            }
+
+            *link = run->next;
+            text_run_destroy(run);
+            cache->num_runs--;
+        }
+    }
+
+    cache->frame = graphics.frame;
+}
+
+float text_width(Font *font, const char *text, const char *end, float scale)
+{
+    float width = 0;
+    unsigned int prev = 0;
+
+    while (*text && text != end)
+    {
+        unsigned int codepoint = utils_utf8_decode(&text);
+
+        if (codepoint < 32)
+            continue;
+
+        width += font_get_kerning(font, prev, codepoint) + font_get_advance(font, codepoint);
+        prev = codepoint;
+    }
+
+    return width * scale;
+}
+
+const char *text_ellipsis(Font *font)
+{
+    if (font->info && stbtt_FindGlyphIndex(font->info, 0x2026))
+        return "\xE2\x80\xA6";
+
+    return "...";
+}
+
+unsigned int text_wrap_push(TextLine **lines, unsigned int *max_lines, unsigned int count, const char *text, const char *start, const char *end, float width, bool ellipsis)
+{
+    if (count == *max_lines)
+    {
+        *max_lines = *max_lines ? *max_lines * 2 : 16;
+        *lines = realloc(*lines, *max_lines * sizeof(TextLine));
+    }
+
+    (*lines)[count] = (TextLine){(unsigned int)(start - text), (unsigned int)(end - start), width, ellipsis};
+
+    return count + 1;
+}
+
+bool text_has_content(const char *text)
+{
+    // Any byte past the space is visible, UTF-8 continuation bytes included
+    while (*text)
+    {
+        if ((unsigned char)*text++ > ' ')
+            return true;
+    }
+
+    return false;
+}
+
+unsigned int text_wrap_truncate(Font *font, const char *text, const char *line, float scale, float max_width, TextLine **lines, unsigned int *max_lines, unsigned int count)
+{
+    float room = max_width - text_width(font, text_ellipsis(font), NULL, scale);
+    float width = 0;
+    const char *s = line, *cut = line;
+    unsigned int prev = 0;
+
+    // As much of the line as fits next to the ellipsis, without a trailing space
+    while (*s && *s != '\n')
+    {
+        unsigned int codepoint = utils_utf8_decode(&s);
+
+        if (codepoint < 32)
+            continue;
+
+        width += (font_get_kerning(font, prev, codepoint) + font_get_advance(font, codepoint)) * scale;
+        prev = codepoint;
+
+        if (max_width > 0 && width > room)
+            break;
+
+        if (codepoint != ' ')
+            cut = s;
+    }
+
+    return text_wrap_push(lines, max_lines, count, text, line, cut, text_width(font, line, cut, scale), true);
+}
+
+void batch_add_text_span(Batch *batch, Vec2 position, Font *font, const char *text, const char *end, float size, Vec4 color)
+{
+    unsigned int count = text_layout(font, text, end, position, size, &batch->text_glyphs, &batch->max_text_glyphs);
+
+    unsigned int i;
+    for (i = 0; i < count; i++)
+        batch_emit_glyph(batch, &batch->text_glyphs[i], color, font->bitmap);
+}
@@ -34,6 +34,11 @@ char *utils_read_file(const char *path)
 }
 
 unsigned char *utils_read_file_bytes(const char *path)
+{
+    return utils_read_file_sized(path, NULL);
+}
+
+unsigned char *utils_read_file_sized(const char *path, size_t *length)
 {
     FILE *file = fopen(path, "rb");
 
@@ -41,20 +46,109 @@ unsigned char *utils_read_file_bytes(const char *path)
         return 0;
 
     fseek(file, 0, SEEK_END);
-    long length = ftell(file);
+    long size = ftell(file);
     fseek(file, 0, SEEK_SET);
 
-    unsigned char *bytes = malloc(length);
+    unsigned char *bytes = malloc(size ? size : 1);
 
-    size_t res = fread(bytes, 1, length, file);
+    size_t res = fread(bytes, 1, size, file);
 
-    if (res < length)
+    if (res < size)
     {
         free(bytes);
         fclose(file);
         return 0;
     }
 
+    if (length)
+        *length = size;
+
     fclose(file);
     return bytes;
-}
\ No newline at end of file
+}
+
+unsigned int utils_utf8_decode(const char **text)
+{
+    const unsigned char *s = (const unsigned char *)*text;
+    unsigned int codepoint, length, i;
+
+    if (s[0] < 0x80)
+    {
+        *text += 1;
+        return s[0];
+    }
+
+    if ((s[0] & 0xE0) == 0xC0)
+    {
+        codepoint = s[0] & 0x1F;
+        length = 2;
+    }
+    else if ((s[0] & 0xF0) == 0xE0)
+    {
+        codepoint = s[0] & 0x0F;
+        length = 3;
+    }
+    else if ((s[0] & 0xF8) == 0xF0)
+    {
+        codepoint = s[0] & 0x07;
+        length = 4;
+    }
+    else
+    {
+        *text += 1;
+        return 0xFFFD;
+    }
+
+    for (i = 1; i < length; i++)
+    {
+        // Also stops at the terminator, so a cut off sequence never reads past it
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            *text += 1;
+            return 0xFFFD;
+        }
+
+        codepoint = (codepoint << 6) | (s[i] & 0x3F);
+    }
+
+    // Overlong encodings, surrogates and anything past the last plane
+    if ((length == 2 && codepoint < 0x80) || (length == 3 && codepoint < 0x800) || (length == 4 && codepoint < 0x10000) ||
+        (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+    {
+        *text += 1;
+        return 0xFFFD;
+    }
+
+    *text += length;
+    return codepoint;
+}
+
+unsigned char pack_unorm8(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 0xFF;
+
+    return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+unsigned short pack_unorm16(float value)
+{
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 1.0f)
+        return 0xFFFF;
+
+    return (unsigned short)(value * 65535.0f + 0.5f);
+}
+
+short pack_snorm16(float value)
+{
+    if (value <= -1.0f)
+        return -0x7FFF;
+    if (value >= 1.0f)
+        return 0x7FFF;
+
+    return (short)(value * 32767.0f + (value < 0.0f ? -0.5f : 0.5f));
+}